@@ -0,0 +1,538 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <float.h>
+
+#include <obs.h>
+#include "volmeter.h"
+#include "volmeter-kernel.h"
+#include "bench.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SAMPLE_RATE 48000.0
+#define NR_SAMPLES 9600
+
+/* Reference true peak: windowed-sinc interpolation with a Kaiser window over
+ * `REF_HALF_TAPS` samples on each side, evaluated at `REF_OVERSAMPLE` points
+ * per sample period. */
+#define REF_HALF_TAPS 64
+#define REF_OVERSAMPLE 32
+#define REF_KAISER_BETA 8.0
+
+/* The kernel and the reference process only the samples not affected by the
+ * edges of the buffer. */
+#define MARGIN (REF_HALF_TAPS + VOLMETER_HISTORY)
+
+enum signal_type {
+	SIGNAL_SILENCE,
+	SIGNAL_DC,
+	SIGNAL_SINE,
+	SIGNAL_SQUARE,
+};
+
+struct golden_signal_s
+{
+	const char *name;
+	enum signal_type type;
+	double amplitude;
+	double frequency;
+	double phase;
+
+	/* A sample at `MARGIN + special_at` is replaced with `special` if not 0. */
+	float special;
+	int special_at;
+
+	/* The true peak is allowed to be lower or higher than the reference by
+	 * these, for the 4-point interpolation, the 4x and 8x FIR. */
+	double true_peak_under_db[3];
+	double true_peak_over_db[3];
+};
+
+/* Tolerances of the true peak are mostly of the 4-point interpolation. Since
+ * the interpolation is not flat, it reads higher than the reference by up to
+ * 1.5 dB, most at fs/4. The FIR filters read within 0.2 dB; the 4x filter
+ * has 0.014 dB of gain at DC and misses a part of the overshoot of the
+ * square wave above its cutoff.
+ * The reference of the signal with NaN treats NaN as 0 while the kernels
+ * drop the points interpolated with NaN. */
+static const struct golden_signal_s signals[] = {
+	{"silence", SIGNAL_SILENCE, 0.0, 0.0, 0.0, 0.0f, 0, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}},
+	{"dc", SIGNAL_DC, 0.5, 0.0, 0.0, 0.0f, 0, {0.01, 0.01, 0.01}, {0.01, 0.02, 0.01}},
+	{"sine-997Hz", SIGNAL_SINE, 0.5, 997.0, 0.0, 0.0f, 0, {0.1, 0.1, 0.1}, {0.1, 0.1, 0.1}},
+	{"sine-6kHz", SIGNAL_SINE, 0.5, 6000.0, 0.3, 0.0f, 0, {0.1, 0.1, 0.1}, {0.2, 0.1, 0.1}},
+	{"sine-fs/4-45deg", SIGNAL_SINE, 1.0, 12000.0, M_PI / 4, 0.0f, 0, {0.1, 0.1, 0.1}, {1.5, 0.1, 0.2}},
+	{"sine-16kHz", SIGNAL_SINE, 0.5, 16000.0, 0.1, 0.0f, 0, {0.1, 0.2, 0.2}, {0.5, 0.1, 0.1}},
+	{"sine-20kHz", SIGNAL_SINE, 0.5, 20000.0, 0.1, 0.0f, 0, {0.5, 0.5, 0.5}, {0.1, 0.1, 0.1}},
+	{"sine-23kHz", SIGNAL_SINE, 0.5, 23000.0, 0.1, 0.0f, 0, {0.5, 0.5, 0.5}, {0.1, 0.1, 0.1}},
+	{"square-1kHz", SIGNAL_SQUARE, 1.0, 1000.0, 0.0, 0.0f, 0, {0.1, 0.2, 0.1}, {0.1, 0.1, 0.1}},
+	{"denormal", SIGNAL_SINE, 1e-39, 997.0, 0.0, 0.0f, 0, {0.1, 0.1, 0.1}, {0.1, 0.1, 0.1}},
+	{"inf", SIGNAL_SINE, 0.5, 997.0, 0.0, INFINITY, 100, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}},
+	{"nan", SIGNAL_SINE, 0.5, 997.0, 0.0, NAN, 100, {0.5, 0.5, 0.5}, {0.1, 0.1, 0.1}},
+};
+
+static void generate(float *buf, size_t n, const struct golden_signal_s *sig)
+{
+	for (size_t i = 0; i < n; i++) {
+		double t = (double)i / SAMPLE_RATE;
+		double x;
+		switch (sig->type) {
+		case SIGNAL_DC:
+			x = sig->amplitude;
+			break;
+		case SIGNAL_SINE:
+			x = sig->amplitude * sin(2.0 * M_PI * sig->frequency * t + sig->phase);
+			break;
+		case SIGNAL_SQUARE:
+			x = fmod(sig->frequency * t, 1.0) < 0.5 ? sig->amplitude : -sig->amplitude;
+			break;
+		case SIGNAL_SILENCE:
+		default:
+			x = 0.0;
+		}
+		buf[i] = (float)x;
+	}
+
+	if (sig->special != 0.0f || isnan(sig->special))
+		buf[MARGIN + sig->special_at] = sig->special;
+}
+
+static double bessel_i0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	for (int k = 1; k < 50; k++) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+static double ref_coefs[REF_OVERSAMPLE][2 * REF_HALF_TAPS];
+
+static double kaiser(double u)
+{
+	if (u <= -1.0 || u >= 1.0)
+		return 0.0;
+	return bessel_i0(REF_KAISER_BETA * sqrt(1.0 - u * u)) / bessel_i0(REF_KAISER_BETA);
+}
+
+static double sinc(double x)
+{
+	if (x == 0.0)
+		return 1.0;
+	return sin(M_PI * x) / (M_PI * x);
+}
+
+static void init_ref_coefs(void)
+{
+	for (int o = 1; o < REF_OVERSAMPLE; o++) {
+		for (int j = 0; j < 2 * REF_HALF_TAPS; j++) {
+			/* Distance from the sample `i + 1 - REF_HALF_TAPS + j` */
+			double d = (double)o / REF_OVERSAMPLE + REF_HALF_TAPS - 1 - j;
+			ref_coefs[o][j] = sinc(d) * kaiser(d / REF_HALF_TAPS);
+		}
+	}
+}
+
+/* Returns the true peak of buf[begin] to buf[end - 1] including the points
+ * between them, ignoring NaN and infinity. */
+static double reference_true_peak(const float *buf, size_t begin, size_t end)
+{
+	double peak = 0.0;
+	for (size_t i = begin; i < end; i++) {
+		if (!isnan(buf[i]))
+			peak = fmax(peak, fabs(buf[i]));
+	}
+
+	for (size_t i = begin; i + 1 < end; i++) {
+		const float *x = buf + i + 1 - REF_HALF_TAPS;
+		for (int o = 1; o < REF_OVERSAMPLE; o++) {
+			double y = 0.0;
+			for (int j = 0; j < 2 * REF_HALF_TAPS; j++) {
+				if (isfinite(x[j]))
+					y += x[j] * ref_coefs[o][j];
+			}
+			peak = fmax(peak, fabs(y));
+		}
+	}
+	return peak;
+}
+
+static double reference_sample_peak(const float *buf, size_t begin, size_t end)
+{
+	double peak = 0.0;
+	for (size_t i = begin; i < end; i++) {
+		if (!isnan(buf[i]))
+			peak = fmax(peak, fabs(buf[i]));
+	}
+	return peak;
+}
+
+static double reference_sum_squares(const float *buf, size_t begin, size_t end)
+{
+	double sum = 0.0;
+	for (size_t i = begin; i < end; i++)
+		sum += (double)buf[i] * buf[i];
+	return sum;
+}
+
+static double to_db(double x)
+{
+	return x > 0.0 ? 20.0 * log10(x) : -INFINITY;
+}
+
+static double error_db(double measured, double reference)
+{
+	return measured == reference ? 0.0 : to_db(measured) - to_db(reference);
+}
+
+/* Returns whether the measured value is within the tolerance in dB. Both being
+ * zero or infinite is also accepted. */
+static bool check_db(double measured, double reference, double under_db, double over_db)
+{
+	if (measured == reference)
+		return true;
+	double error = error_db(measured, reference);
+	return -under_db <= error && error <= over_db;
+}
+
+static bool check_sum_squares(double measured, double reference)
+{
+	if (isnan(reference))
+		return isnan(measured);
+	if (isinf(reference))
+		return measured == reference;
+	/* The squares of denormal samples are flushed to 0. */
+	if (reference < FLT_MIN)
+		return measured < FLT_MIN;
+	/* Not exact since the kernels sum in float with compensation. */
+	return fabs(measured - reference) <= reference * 1e-5;
+}
+
+/* Lengths and offsets of the windows compared between the kernels, covering
+ * the leading and trailing samples of each vector width. */
+static const size_t equivalence_lengths[] = {0,  1,  2,  3,  4,  5,  7,  8,  9,  11,  12,  13,
+					     15, 16, 17, 31, 32, 33, 63, 64, 65, 101, 480, 1024};
+#define EQUIVALENCE_MAX_OFFSET 15
+
+/* The peak has to be bit-exact among the kernels. The sum of the squares is
+ * accumulated in different order by each kernel, so it is compared within
+ * a few ULPs. */
+static bool same_peak(float a, float b)
+{
+	return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+static bool same_sum_squares(float a, float b)
+{
+	if (a == b || (isnan(a) && isnan(b)))
+		return true;
+	if (isinf(a) || isinf(b) || isnan(a) || isnan(b))
+		return false;
+	return fabsf(a - b) <= fmaxf(fabsf(a), fabsf(b)) * 4.0f * FLT_EPSILON;
+}
+
+/* Compares the results of `kernel` with the plain-C kernel for the samples
+ * from `samples`, with the previous samples in front of them. Returns the
+ * number of the mismatches after printing them to stderr. */
+static int compare_with_c(const struct volmeter_kernel_s *kernel, const char *id, const char *context,
+			  const float *samples, size_t nr_samples)
+{
+	int nr_mismatches = 0;
+	for (int f = 0; f < BENCH_NR_FUNCTIONS; f++) {
+		float sum_squares, sum_squares_c;
+		const float *prev = samples - VOLMETER_HISTORY;
+		float peak = bench_call(kernel, f, prev, samples, nr_samples, &sum_squares);
+		float peak_c = bench_call(&volmeter_kernel_c, f, prev, samples, nr_samples, &sum_squares_c);
+		if (same_peak(peak, peak_c) && same_sum_squares(sum_squares, sum_squares_c))
+			continue;
+
+		fprintf(stderr, "%s: %s %s differs from C for %zu samples: peak %a vs %a, sum_squares %a vs %a\n",
+			context, id, bench_function_names[f], nr_samples, peak, peak_c, sum_squares, sum_squares_c);
+		nr_mismatches++;
+	}
+	return nr_mismatches;
+}
+
+/* Compares each kernel with the plain-C kernel for the golden signals in
+ * windows of several lengths at every misalignment. */
+static int check_equivalence(float *buf, const struct volmeter_kernel_s **kernels, const char **ids,
+			     size_t nr_kernels)
+{
+	int nr_mismatches = 0;
+	for (size_t s = 0; s < sizeof(signals) / sizeof(*signals); s++) {
+		const struct golden_signal_s *sig = &signals[s];
+		generate(buf, NR_SAMPLES + 2 * MARGIN, sig);
+
+		for (size_t k = 0; k < nr_kernels && k < VOLMETER_KERNEL_MAX; k++) {
+			if (kernels[k] == &volmeter_kernel_c)
+				continue;
+			int n = 0;
+			for (size_t l = 0; l < sizeof(equivalence_lengths) / sizeof(*equivalence_lengths); l++) {
+				for (size_t offset = 0; offset <= EQUIVALENCE_MAX_OFFSET; offset++) {
+					n += compare_with_c(kernels[k], ids[k], sig->name, buf + MARGIN + offset,
+							    equivalence_lengths[l]);
+				}
+			}
+			printf("%s,%s,equivalence,,,,,%s\n", sig->name, ids[k], n ? "FAIL" : "pass");
+			nr_mismatches += n;
+		}
+	}
+	return nr_mismatches;
+}
+
+/* Fuzzing with random lengths and misalignments, mostly for the leading and
+ * trailing samples of the SIMD kernels. The samples are occasionally replaced
+ * with special values. */
+#define FUZZ_SEED 0x5eed1234u
+#define FUZZ_ITERATIONS 20000
+#define FUZZ_MAX_SAMPLES 100
+#define FUZZ_MAX_OFFSET 15
+#define FUZZ_BUFFER (VOLMETER_HISTORY + FUZZ_MAX_OFFSET + FUZZ_MAX_SAMPLES)
+
+/* Same sequence on every platform, unlike `rand`. */
+static uint32_t fuzz_random(uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+static float fuzz_sample(uint32_t *state)
+{
+	static const float specials[] = {0.0f, -0.0f, 1.5f, -1.5f, 1e-39f, INFINITY, -INFINITY, NAN};
+	uint32_t r = fuzz_random(state);
+	if (r % 64 == 0)
+		return specials[(r >> 6) % (sizeof(specials) / sizeof(*specials))];
+	return (float)(r >> 8) / (float)(1 << 23) - 1.0f;
+}
+
+static int check_fuzz(const struct volmeter_kernel_s **kernels, const char **ids, size_t nr_kernels)
+{
+	/* The offset is counted from a 64-byte boundary so that it covers
+	 * every misalignment of the vectors up to AVX-512. */
+	void *raw = malloc(sizeof(float) * FUZZ_BUFFER + 64);
+	if (!raw) {
+		fprintf(stderr, "Error: failed to allocate buffer\n");
+		return 1;
+	}
+	float *buf = (float *)(((uintptr_t)raw + 63) & ~(uintptr_t)63);
+
+	uint32_t state = FUZZ_SEED;
+	int nr_mismatches[VOLMETER_KERNEL_MAX] = {0};
+	for (int it = 0; it < FUZZ_ITERATIONS; it++) {
+		for (size_t i = 0; i < FUZZ_BUFFER; i++)
+			buf[i] = fuzz_sample(&state);
+		size_t nr_samples = fuzz_random(&state) % (FUZZ_MAX_SAMPLES + 1);
+		size_t offset = fuzz_random(&state) % (FUZZ_MAX_OFFSET + 1);
+
+		char context[64];
+		snprintf(context, sizeof(context), "fuzz iteration %d offset %zu", it, offset);
+		for (size_t k = 0; k < nr_kernels && k < VOLMETER_KERNEL_MAX; k++) {
+			if (kernels[k] != &volmeter_kernel_c)
+				nr_mismatches[k] += compare_with_c(kernels[k], ids[k], context,
+								   buf + VOLMETER_HISTORY + offset, nr_samples);
+		}
+	}
+
+	int total = 0;
+	for (size_t k = 0; k < nr_kernels && k < VOLMETER_KERNEL_MAX; k++) {
+		if (kernels[k] == &volmeter_kernel_c)
+			continue;
+		printf("fuzz,%s,equivalence,,,,,%s\n", ids[k], nr_mismatches[k] ? "FAIL" : "pass");
+		total += nr_mismatches[k];
+	}
+
+	free(raw);
+	return total;
+}
+
+/* Pushes the golden signals to `volmeter_push_audio_data` in packets of random
+ * sizes, including packets shorter than the previous samples kept by the
+ * volmeter. Since the previous samples are carried across the packets, the
+ * peak over the packets has to be the same to the bit as the plain-C kernel
+ * for the whole window. The second channel has the same samples at another
+ * misalignment. */
+#define PACKET_SEED 0x9ac4e75u
+#define PACKET_MAX_FRAMES 1024
+#define PACKET_NR_CHANNELS 2
+
+struct packet_levels_s
+{
+	uint32_t nr_packets;
+	uint32_t nr_channels;
+	float peak[PACKET_NR_CHANNELS];
+	double sum_squares[PACKET_NR_CHANNELS];
+};
+
+static void packet_levels_updated(void *param, const struct volmeter_levels_s *levels)
+{
+	struct packet_levels_s *acc = param;
+	acc->nr_packets++;
+	acc->nr_channels = levels->nr_channels;
+	for (uint32_t ch = 0; ch < levels->nr_channels && ch < PACKET_NR_CHANNELS; ch++) {
+		acc->peak[ch] = fmaxf(acc->peak[ch], levels->peak[ch]);
+		acc->sum_squares[ch] += (double)levels->magnitude[ch] * levels->magnitude[ch] * levels->nr_frames;
+	}
+}
+
+static size_t packet_size(uint32_t *state)
+{
+	uint32_t r = fuzz_random(state);
+	if (r % 8 == 0)
+		return 1 + (r >> 3) % VOLMETER_HISTORY;
+	return 1 + (r >> 3) % PACKET_MAX_FRAMES;
+}
+
+/* Pushes the samples from `begin` to `end` in one packet if `state` is NULL. */
+static void push_packets(volmeter_t *volmeter, float *const planes[PACKET_NR_CHANNELS], size_t begin, size_t end,
+			 uint32_t *state)
+{
+	while (begin < end) {
+		size_t nr_frames = state ? packet_size(state) : end - begin;
+		if (nr_frames > end - begin)
+			nr_frames = end - begin;
+
+		struct audio_data data = {0};
+		for (int ch = 0; ch < PACKET_NR_CHANNELS; ch++)
+			data.data[ch] = (uint8_t *)(planes[ch] + begin);
+		data.frames = (uint32_t)nr_frames;
+		volmeter_push_audio_data(volmeter, &data);
+		begin += nr_frames;
+	}
+}
+
+static int check_packets(float *buf)
+{
+	const size_t begin = MARGIN;
+	const size_t end = MARGIN + NR_SAMPLES;
+	float *copy = malloc(sizeof(float) * (NR_SAMPLES + 2 * MARGIN + 1));
+	if (!copy) {
+		fprintf(stderr, "Error: failed to allocate buffer\n");
+		return 1;
+	}
+	float *const planes[PACKET_NR_CHANNELS] = {buf, copy + 1};
+
+	uint32_t state = PACKET_SEED;
+	int nr_failures = 0;
+	for (size_t s = 0; s < sizeof(signals) / sizeof(*signals); s++) {
+		const struct golden_signal_s *sig = &signals[s];
+		generate(buf, NR_SAMPLES + 2 * MARGIN, sig);
+		memcpy(planes[1], buf, sizeof(float) * (NR_SAMPLES + 2 * MARGIN));
+
+		double ref_sum_squares = reference_sum_squares(buf, begin, end);
+
+		for (int f = 0; f < BENCH_NR_FUNCTIONS; f++) {
+			float sum_squares_c;
+			float peak_c = bench_call(&volmeter_kernel_c, f, buf + begin - VOLMETER_HISTORY, buf + begin,
+						  NR_SAMPLES, &sum_squares_c);
+
+			volmeter_t *volmeter = volmeter_create();
+			volmeter_set_peak_meter_type(volmeter, bench_peak_types[f]);
+			struct packet_levels_s acc = {0};
+			volmeter_add_callback(volmeter, packet_levels_updated, &acc);
+
+			/* The samples before the window fill the previous
+			 * samples as the reference has. */
+			push_packets(volmeter, planes, 0, begin, NULL);
+			memset(&acc, 0, sizeof(acc));
+			push_packets(volmeter, planes, begin, end, &state);
+
+			volmeter_remove_callback(volmeter, packet_levels_updated, &acc);
+			volmeter_destroy(volmeter);
+
+			bool ok = acc.nr_packets > 0 && acc.nr_channels == PACKET_NR_CHANNELS;
+			for (int ch = 0; ch < PACKET_NR_CHANNELS; ch++) {
+				ok = ok && same_peak(acc.peak[ch], peak_c);
+				ok = ok && check_sum_squares(acc.sum_squares[ch], ref_sum_squares);
+			}
+			if (!ok) {
+				fprintf(stderr, "%s: volmeter %s differs from C: peak %a %a vs %a\n", sig->name,
+					bench_function_names[f], acc.peak[0], acc.peak[1], peak_c);
+				nr_failures++;
+			}
+
+			double sum_error = ref_sum_squares >= FLT_MIN && isfinite(ref_sum_squares)
+						   ? (acc.sum_squares[0] - ref_sum_squares) / ref_sum_squares
+						   : 0.0;
+			printf("%s,volmeter,%s,%.4f,%.4f,%.4f,%.3g,%s\n", sig->name, bench_function_names[f],
+			       to_db(acc.peak[0]), to_db(peak_c), error_db(acc.peak[0], peak_c), sum_error,
+			       ok ? "pass" : "FAIL");
+		}
+	}
+
+	free(copy);
+	return nr_failures;
+}
+
+int run_accuracy(void)
+{
+	float *buf = malloc(sizeof(float) * (NR_SAMPLES + 2 * MARGIN));
+	if (!buf) {
+		fprintf(stderr, "Error: failed to allocate buffer\n");
+		return 1;
+	}
+
+	const struct volmeter_kernel_s *kernels[VOLMETER_KERNEL_MAX];
+	const char *ids[VOLMETER_KERNEL_MAX];
+	size_t nr_kernels = volmeter_kernel_get_supported(kernels, ids, VOLMETER_KERNEL_MAX);
+
+	init_ref_coefs();
+
+	const size_t begin = MARGIN;
+	const size_t end = MARGIN + NR_SAMPLES;
+	int nr_failures = 0;
+
+	printf("signal,kernel,function,peak_db,reference_db,error_db,sum_squares_error,result\n");
+	for (size_t s = 0; s < sizeof(signals) / sizeof(*signals); s++) {
+		const struct golden_signal_s *sig = &signals[s];
+		generate(buf, NR_SAMPLES + 2 * MARGIN, sig);
+
+		/* The interpolation of the kernels covers the points from
+		 * the previous samples. */
+		double ref_true_peak = reference_true_peak(buf, begin - 2, end);
+		double ref_sample_peak = reference_sample_peak(buf, begin, end);
+		double ref_sum_squares = reference_sum_squares(buf, begin, end);
+
+		for (size_t k = 0; k < nr_kernels && k < VOLMETER_KERNEL_MAX; k++) {
+			for (int f = 0; f < BENCH_NR_FUNCTIONS; f++) {
+				const bool true_peak = f != BENCH_SAMPLE_PEAK;
+				float sum_squares;
+				float peak = bench_call(kernels[k], f, buf + begin - VOLMETER_HISTORY, buf + begin,
+							NR_SAMPLES, &sum_squares);
+
+				double ref = true_peak ? ref_true_peak : ref_sample_peak;
+				bool ok = true_peak ? check_db(peak, ref, sig->true_peak_under_db[f - 1],
+							       sig->true_peak_over_db[f - 1])
+						    : peak == (float)ref;
+				ok = ok && check_sum_squares(sum_squares, ref_sum_squares);
+				if (!ok)
+					nr_failures++;
+
+				double sum_error = ref_sum_squares >= FLT_MIN && isfinite(ref_sum_squares)
+							   ? (sum_squares - ref_sum_squares) / ref_sum_squares
+							   : 0.0;
+				printf("%s,%s,%s,%.4f,%.4f,%.4f,%.3g,%s\n", sig->name, ids[k],
+				       bench_function_names[f], to_db(peak), to_db(ref),
+				       error_db(peak, ref), sum_error, ok ? "pass" : "FAIL");
+			}
+		}
+	}
+
+	nr_failures += check_equivalence(buf, kernels, ids, nr_kernels);
+	nr_failures += check_fuzz(kernels, ids, nr_kernels);
+	nr_failures += check_packets(buf);
+
+	free(buf);
+
+	if (nr_failures)
+		fprintf(stderr, "%d results out of the tolerance\n", nr_failures);
+	return nr_failures ? 1 : 0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <obs.h>
+#include "volmeter.h"
+#include "volmeter-kernel.h"
+
+enum bench_function {
+	BENCH_SAMPLE_PEAK,
+	BENCH_TRUE_PEAK,
+	BENCH_TRUE_PEAK_FIR4,
+	BENCH_TRUE_PEAK_FIR8,
+	BENCH_NR_FUNCTIONS,
+};
+
+static const char *const bench_function_names[BENCH_NR_FUNCTIONS] = {
+	"sample_peak",
+	"true_peak",
+	"true_peak_fir4",
+	"true_peak_fir8",
+};
+
+static const enum volmeter_peak_type bench_peak_types[BENCH_NR_FUNCTIONS] = {
+	VOLMETER_SAMPLE_PEAK,
+	VOLMETER_TRUE_PEAK,
+	VOLMETER_TRUE_PEAK_FIR4,
+	VOLMETER_TRUE_PEAK_FIR8,
+};
+
+/* Calls the function of the kernel. `prev` has `VOLMETER_HISTORY` samples. */
+static inline float bench_call(const struct volmeter_kernel_s *kernel, enum bench_function func,
+			       const float prev[VOLMETER_HISTORY], const float *samples, size_t nr_samples,
+			       float *sum_squares)
+{
+	const float *prev4 = prev + VOLMETER_HISTORY - 4;
+	switch (func) {
+	case BENCH_TRUE_PEAK:
+		return kernel->true_peak(prev4, samples, nr_samples, sum_squares);
+	case BENCH_TRUE_PEAK_FIR4:
+		return kernel->fir_true_peak(&volmeter_fir_4x, prev, samples, nr_samples, sum_squares);
+	case BENCH_TRUE_PEAK_FIR8:
+		return kernel->fir_true_peak(&volmeter_fir_8x, prev, samples, nr_samples, sum_squares);
+	case BENCH_SAMPLE_PEAK:
+	default:
+		return kernel->sample_peak(prev4, samples, nr_samples, sum_squares);
+	}
+}
+
+/* Compares the kernels with the reference for the golden signals and prints
+ * the results in CSV. Returns non-zero if any result is out of the tolerance. */
+int run_accuracy(void);
@@ -0,0 +1,6 @@
+#pragma once
+
+enum obs_peak_meter_type {
+	SAMPLE_PEAK_METER,
+	TRUE_PEAK_METER,
+};
@@ -0,0 +1,109 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "obs.h"
+
+struct obs_audio_info obs_stub_audio_info = {48000, SPEAKERS_STEREO};
+
+void blog(int log_level, const char *format, ...)
+{
+	if (log_level > LOG_WARNING)
+		return;
+
+	va_list args;
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+	fputc('\n', stderr);
+}
+
+bool obs_get_audio_info(struct obs_audio_info *oai)
+{
+	*oai = obs_stub_audio_info;
+	return true;
+}
+
+obs_data_t *obs_data_create(void)
+{
+	return NULL;
+}
+
+void obs_data_release(obs_data_t *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+void obs_data_set_int(obs_data_t *data, const char *name, long long val)
+{
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(name);
+	UNUSED_PARAMETER(val);
+}
+
+void obs_data_set_obj(obs_data_t *data, const char *name, obs_data_t *obj)
+{
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(name);
+	UNUSED_PARAMETER(obj);
+}
+
+uint64_t os_gettime_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void os_sleep_ms(uint32_t duration)
+{
+	usleep(duration * 1000);
+}
+
+struct os_event_data
+{
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool signalled;
+	bool manual;
+};
+
+int os_event_init(os_event_t **event, enum os_event_type type)
+{
+	os_event_t *data = bzalloc(sizeof(os_event_t));
+	pthread_mutex_init(&data->mutex, NULL);
+	pthread_cond_init(&data->cond, NULL);
+	data->manual = type == OS_EVENT_TYPE_MANUAL;
+	*event = data;
+	return 0;
+}
+
+void os_event_destroy(os_event_t *event)
+{
+	if (!event)
+		return;
+	pthread_cond_destroy(&event->cond);
+	pthread_mutex_destroy(&event->mutex);
+	bfree(event);
+}
+
+int os_event_wait(os_event_t *event)
+{
+	pthread_mutex_lock(&event->mutex);
+	while (!event->signalled)
+		pthread_cond_wait(&event->cond, &event->mutex);
+	if (!event->manual)
+		event->signalled = false;
+	pthread_mutex_unlock(&event->mutex);
+	return 0;
+}
+
+int os_event_signal(os_event_t *event)
+{
+	pthread_mutex_lock(&event->mutex);
+	event->signalled = true;
+	pthread_cond_broadcast(&event->cond);
+	pthread_mutex_unlock(&event->mutex);
+	return 0;
+}
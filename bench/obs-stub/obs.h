@@ -0,0 +1,93 @@
+#pragma once
+
+/* Minimal subset of libobs to build the volmeter without OBS for the
+ * benchmark and the tests. Only what src/volmeter.c and its dependencies use
+ * is declared, with the same signatures as libobs. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "util/c99defs.h"
+#include "util/bmem.h"
+#include "util/threading.h"
+#include "util/platform.h"
+#include "obs-audio-controls.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MAX_AV_PLANES 8
+#define MAX_AUDIO_MIXES 6
+#define MAX_AUDIO_CHANNELS 8
+
+#define LOG_ERROR 100
+#define LOG_WARNING 200
+#define LOG_INFO 300
+#define LOG_DEBUG 400
+
+void blog(int log_level, const char *format, ...);
+
+enum speaker_layout {
+	SPEAKERS_UNKNOWN,
+	SPEAKERS_MONO,
+	SPEAKERS_STEREO,
+	SPEAKERS_2POINT1,
+	SPEAKERS_4POINT0,
+	SPEAKERS_4POINT1,
+	SPEAKERS_5POINT1,
+	SPEAKERS_7POINT1 = 8,
+};
+
+static inline uint32_t get_audio_channels(enum speaker_layout speakers)
+{
+	switch (speakers) {
+	case SPEAKERS_MONO:
+		return 1;
+	case SPEAKERS_STEREO:
+		return 2;
+	case SPEAKERS_2POINT1:
+		return 3;
+	case SPEAKERS_4POINT0:
+		return 4;
+	case SPEAKERS_4POINT1:
+		return 5;
+	case SPEAKERS_5POINT1:
+		return 6;
+	case SPEAKERS_7POINT1:
+		return 8;
+	case SPEAKERS_UNKNOWN:
+	default:
+		return 0;
+	}
+}
+
+struct audio_data
+{
+	uint8_t *data[MAX_AV_PLANES];
+	uint32_t frames;
+	uint64_t timestamp;
+};
+
+struct obs_audio_info
+{
+	uint32_t samples_per_sec;
+	enum speaker_layout speakers;
+};
+
+/* Returns `obs_stub_audio_info`, 48 kHz stereo unless changed. */
+bool obs_get_audio_info(struct obs_audio_info *oai);
+extern struct obs_audio_info obs_stub_audio_info;
+
+/* The data is not stored. */
+typedef struct obs_data obs_data_t;
+obs_data_t *obs_data_create(void);
+void obs_data_release(obs_data_t *data);
+void obs_data_set_int(obs_data_t *data, const char *name, long long val);
+void obs_data_set_obj(obs_data_t *data, const char *name, obs_data_t *obj);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdlib.h>
+#include <string.h>
+
+static inline void *bmalloc(size_t size)
+{
+	void *ptr = malloc(size ? size : 1);
+	if (!ptr)
+		abort();
+	return ptr;
+}
+
+static inline void *bzalloc(size_t size)
+{
+	void *ptr = bmalloc(size);
+	memset(ptr, 0, size);
+	return ptr;
+}
+
+static inline void bfree(void *ptr)
+{
+	free(ptr);
+}
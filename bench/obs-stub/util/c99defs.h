@@ -0,0 +1,3 @@
+#pragma once
+
+#define UNUSED_PARAMETER(param) (void)param
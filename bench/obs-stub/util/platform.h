@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+uint64_t os_gettime_ns(void);
+void os_sleep_ms(uint32_t duration);
@@ -0,0 +1,211 @@
+/* Measures the time to process one audio packet by each kernel supported by
+ * the running CPU and prints the results in CSV to stdout.
+ * The kernel `volmeter` is `volmeter_push_audio_data` with the kernel chosen
+ * at runtime, including publishing the levels to a callback and the loudness.
+ *
+ * Usage: volmeter-bench [kernel-id]...
+ * If kernel IDs are given, only those kernels are measured.
+ *
+ * Usage: volmeter-bench --accuracy
+ * Checks the accuracy of the kernels with the golden signals instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include <obs.h>
+#include "volmeter.h"
+#include "volmeter-kernel.h"
+#include "bench.h"
+
+#define MAX_CHANNELS 8
+#define MAX_OFFSET 3
+#define SAMPLES_PER_RUN (1 << 20)
+#define NR_RUNS 5
+
+static const size_t frame_sizes[] = {64, 256, 480, 1024, 4096};
+
+static uint64_t now_ns(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER count, freq;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&freq);
+	return (uint64_t)((double)count.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/* Prevents the compiler from removing the calls. */
+static volatile float sink;
+
+/* Returns the best time per sample among the runs. */
+static double measure(const struct volmeter_kernel_s *kernel, enum bench_function func, float *planes[MAX_CHANNELS],
+		      int nr_channels, size_t nr_frames, size_t offset)
+{
+	const float prev[VOLMETER_HISTORY] = {0};
+	size_t iterations = SAMPLES_PER_RUN / (nr_frames * nr_channels);
+	if (iterations < 1)
+		iterations = 1;
+
+	double best = INFINITY;
+	for (int run = 0; run < NR_RUNS; run++) {
+		float acc = 0.0f;
+		uint64_t start = now_ns();
+		for (size_t it = 0; it < iterations; it++) {
+			for (int ch = 0; ch < nr_channels; ch++) {
+				float sum_squares;
+				acc += bench_call(kernel, func, prev, planes[ch] + offset, nr_frames, &sum_squares);
+				acc += sum_squares;
+			}
+		}
+		uint64_t end = now_ns();
+		sink = acc;
+
+		double ns = (double)(end - start) / ((double)iterations * nr_frames * nr_channels);
+		if (ns < best)
+			best = ns;
+	}
+	return best;
+}
+
+static void levels_updated(void *param, const struct volmeter_levels_s *levels)
+{
+	float *acc = param;
+	*acc += levels->peak[0];
+}
+
+/* Same as `measure` but through `volmeter_push_audio_data`. */
+static double measure_volmeter(enum bench_function func, bool loudness, float *planes[MAX_CHANNELS], int nr_channels,
+			       size_t nr_frames, size_t offset)
+{
+	volmeter_t *volmeter = volmeter_create();
+	volmeter_set_peak_meter_type(volmeter, bench_peak_types[func]);
+	volmeter_set_loudness(volmeter, loudness);
+
+	float acc = 0.0f;
+	volmeter_add_callback(volmeter, levels_updated, &acc);
+
+	struct audio_data data = {0};
+	for (int ch = 0; ch < nr_channels; ch++)
+		data.data[ch] = (uint8_t *)(planes[ch] + offset);
+	data.frames = (uint32_t)nr_frames;
+
+	size_t iterations = SAMPLES_PER_RUN / (nr_frames * nr_channels);
+	if (iterations < 1)
+		iterations = 1;
+
+	double best = INFINITY;
+	for (int run = 0; run < NR_RUNS; run++) {
+		uint64_t start = now_ns();
+		for (size_t it = 0; it < iterations; it++)
+			volmeter_push_audio_data(volmeter, &data);
+		uint64_t end = now_ns();
+
+		double ns = (double)(end - start) / ((double)iterations * nr_frames * nr_channels);
+		if (ns < best)
+			best = ns;
+	}
+
+	volmeter_remove_callback(volmeter, levels_updated, &acc);
+	volmeter_destroy(volmeter);
+	sink = acc;
+	return best;
+}
+
+static void run_volmeter(float *planes[MAX_CHANNELS])
+{
+	for (int loudness = 0; loudness <= 1; loudness++) {
+		for (int f = 0; f < BENCH_NR_FUNCTIONS; f++) {
+			for (int nr_channels = 1; nr_channels <= MAX_CHANNELS; nr_channels++) {
+				for (size_t i = 0; i < sizeof(frame_sizes) / sizeof(*frame_sizes); i++) {
+					for (size_t offset = 0; offset <= MAX_OFFSET; offset++) {
+						double ns = measure_volmeter(f, loudness, planes, nr_channels,
+									     frame_sizes[i], offset);
+						printf("volmeter,%s%s,%d,%zu,%zu,%.4f\n", bench_function_names[f],
+						       loudness ? "+loudness" : "", nr_channels, frame_sizes[i], offset,
+						       ns);
+					}
+				}
+			}
+			fflush(stdout);
+		}
+	}
+}
+
+static int kernel_selected(const char *id, int argc, char **argv)
+{
+	if (argc <= 1)
+		return 1;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], id) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 1 && strcmp(argv[1], "--accuracy") == 0)
+		return run_accuracy();
+
+	const size_t max_frames = frame_sizes[sizeof(frame_sizes) / sizeof(*frame_sizes) - 1];
+
+	/* Allocate each plane separately as libobs does, with a margin for
+	 * the offset. Large allocations are aligned enough by malloc. */
+	float *planes[MAX_CHANNELS];
+	srand(1);
+	for (int ch = 0; ch < MAX_CHANNELS; ch++) {
+		planes[ch] = malloc(sizeof(float) * (max_frames + MAX_OFFSET));
+		if (!planes[ch]) {
+			fprintf(stderr, "Error: failed to allocate buffer\n");
+			return 1;
+		}
+		for (size_t i = 0; i < max_frames + MAX_OFFSET; i++)
+			planes[ch][i] = (float)rand() / RAND_MAX * 2.0f - 1.0f;
+	}
+
+	const struct volmeter_kernel_s *kernels[VOLMETER_KERNEL_MAX];
+	const char *ids[VOLMETER_KERNEL_MAX];
+	size_t nr_kernels = volmeter_kernel_get_supported(kernels, ids, VOLMETER_KERNEL_MAX);
+
+	printf("kernel,function,channels,frames,offset,ns_per_sample\n");
+	for (size_t k = 0; k < nr_kernels && k < VOLMETER_KERNEL_MAX; k++) {
+		if (!kernel_selected(ids[k], argc, argv))
+			continue;
+
+		for (int f = 0; f < BENCH_NR_FUNCTIONS; f++) {
+			for (int nr_channels = 1; nr_channels <= MAX_CHANNELS; nr_channels++) {
+				for (size_t i = 0; i < sizeof(frame_sizes) / sizeof(*frame_sizes); i++) {
+					for (size_t offset = 0; offset <= MAX_OFFSET; offset++) {
+						double ns = measure(kernels[k], f, planes, nr_channels, frame_sizes[i],
+								    offset);
+						printf("%s,%s,%d,%zu,%zu,%.4f\n", ids[k], bench_function_names[f], nr_channels,
+						       frame_sizes[i], offset, ns);
+					}
+				}
+			}
+			fflush(stdout);
+		}
+	}
+
+	if (kernel_selected("volmeter", argc, argv))
+		run_volmeter(planes);
+
+	for (int ch = 0; ch < MAX_CHANNELS; ch++)
+		free(planes[ch]);
+
+	return 0;
+}
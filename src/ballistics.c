@@ -0,0 +1,100 @@
+/*
+Graphical Volume Meter Plugin for OBS Studio
+Copyright (C) 2026 Norihiro Kamae <norihiro@nagater.net>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <float.h>
+#include <math.h>
+#include <obs.h>
+#include "ballistics.h"
+
+/* These are pointless warnings generated not by our code, but by a standard
+ * library macro, INFINITY */
+#ifdef _MSC_VER
+#pragma warning(disable : 4056)
+#pragma warning(disable : 4756)
+#endif
+
+void ballistics_reset(struct ballistics_s *b, uint32_t first, uint32_t count)
+{
+	for (uint32_t i = first; i < first + count && i < BALLISTICS_MAX_CHANNELS; i++) {
+		b->magnitude[i] = -INFINITY;
+		b->peak[i] = -INFINITY;
+		b->display_magnitude[i] = -INFINITY;
+		b->display_peak[i] = -INFINITY;
+		b->peak_hold[i] = -INFINITY;
+		b->peak_hold_age[i] = 0.0f;
+		b->clip_flash[i] = 0;
+		b->clip_flash_age[i] = 0.0f;
+	}
+}
+
+/* Same as `isfinite`, `fminf` and `fmaxf` for the values here but written as
+ * comparisons so that the loop below is vectorized. */
+static inline int is_finite(float x)
+{
+	return fabsf(x) <= FLT_MAX;
+}
+
+static inline float min_flt(float a, float b)
+{
+	return a < b ? a : b;
+}
+
+static inline float max_flt(float a, float b)
+{
+	return a > b ? a : b;
+}
+
+void ballistics_tick(struct ballistics_s *b, const struct ballistics_params_s *params, float duration)
+{
+	const float attack = duration * params->magnitude_attack_rate;
+	const float decay = duration * params->peak_decay_rate;
+	const float mag_min = params->magnitude_min;
+	const float hold_duration = params->peak_hold_duration;
+	const float flash_duration = params->clip_flash_duration;
+	/* A multiple of 4 lets the loop be vectorized without the scalar
+	 * remainder, which the cost model at -O2 requires. */
+	const uint32_t n = (b->nr_channels + 3) & ~3u;
+
+	/* Every condition is a select without short-circuit so that the
+	 * compiler can vectorize the loop with min, max and blend. */
+	for (uint32_t i = 0; i < n; i++) {
+		const float mag = b->magnitude[i];
+		const float peak = b->peak[i];
+
+		float dm = b->display_magnitude[i];
+		float attacked = min_flt(max_flt(dm + (mag - dm) * attack, mag_min), 0.0f);
+		b->display_magnitude[i] = is_finite(dm) ? attacked : mag;
+
+		float dp = b->display_peak[i];
+		float decayed = min_flt(max_flt(dp - decay, peak), 0.0f);
+		b->display_peak[i] = ((peak >= dp) | (dp != dp)) ? peak : decayed;
+
+		float hold = b->peak_hold[i];
+		float hold_age = b->peak_hold_age[i];
+		int32_t hold_reset = (peak >= hold) | !is_finite(hold) | (hold_age > hold_duration);
+		b->peak_hold[i] = hold_reset ? peak : hold;
+		b->peak_hold_age[i] = hold_reset ? 0.0f : hold_age + duration;
+
+		int32_t flash = b->clip_flash[i] & (b->clip_flash_age[i] < flash_duration);
+		float flash_age = flash ? b->clip_flash_age[i] + duration : b->clip_flash_age[i];
+		int32_t flash_start = (peak >= 0.0f) & !flash;
+		b->clip_flash[i] = flash | flash_start;
+		b->clip_flash_age[i] = flash_start ? 0.0f : flash_age;
+	}
+}
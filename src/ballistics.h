@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <obs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* In the bank mode, one source draws several meters side by side, sharing the
+ * labels, the effect, the vertex buffers and the ballistics. */
+#define MAX_METERS 32
+
+/* Maximum number of the channels of all the meters of one source. */
+#define BALLISTICS_MAX_CHANNELS (MAX_METERS * MAX_AUDIO_CHANNELS)
+
+/* Displayed levels of the channels in dB, in structure of arrays so that one
+ * loop without branches updates all the channels at once.
+ * `magnitude` and `peak` are the input for the next tick.
+ * `nr_channels` is rounded up to a multiple of 4 when ticking, so the channels
+ * up to there have to be kept in the reset state. */
+struct ballistics_s
+{
+	uint32_t nr_channels;
+	float magnitude[BALLISTICS_MAX_CHANNELS];
+	float peak[BALLISTICS_MAX_CHANNELS];
+
+	float display_magnitude[BALLISTICS_MAX_CHANNELS];
+	float display_peak[BALLISTICS_MAX_CHANNELS];
+	float peak_hold[BALLISTICS_MAX_CHANNELS];
+	float peak_hold_age[BALLISTICS_MAX_CHANNELS];
+	int32_t clip_flash[BALLISTICS_MAX_CHANNELS]; // 0 or 1
+	float clip_flash_age[BALLISTICS_MAX_CHANNELS];
+};
+
+struct ballistics_params_s
+{
+	float magnitude_attack_rate; // [1/s]
+	float magnitude_min;         // [dB]
+	float peak_decay_rate;       // [dB/s]
+	float peak_hold_duration;    // [s]
+	float clip_flash_duration;   // [s]
+};
+
+/* Sets the channels from `first` to `first + count` to the initial state. */
+void ballistics_reset(struct ballistics_s *b, uint32_t first, uint32_t count);
+
+void ballistics_tick(struct ballistics_s *b, const struct ballistics_params_s *params, float duration);
+
+#ifdef __cplusplus
+}
+#endif
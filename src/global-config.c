@@ -1,3 +1,4 @@
+#include <inttypes.h>
 #include <obs-module.h>
 #include <obs-frontend-api.h>
 #include <util/config-file.h>
@@ -12,6 +13,14 @@ static volatile long refcnt = 0;
 struct global_config_s gcfg = {0};
 gs_image_file_t label_image = {0};
 
+/* The labels don't change unless the height of the meter or the image is
+ * changed. Since all the sources have the same height for now, only the last
+ * one is kept. */
+static gs_vertbuffer_t *label_vbuf = NULL;
+static uint32_t label_vbuf_height = 0;
+static uint32_t label_vbuf_cx = 0;
+static uint32_t label_vbuf_cy = 0;
+
 static inline uint32_t color_from_cfg(long long value)
 {
 	return (value & 0xFF) << 16 | (value & 0xFF00) | (value & 0xFF0000) >> 16 | 0xFF000000;
@@ -53,6 +62,8 @@ static void gcfg_update()
 	c.color_fg_warning = color_from_cfg(config_get_int(user, "Accessibility", "MixerYellowActive"));
 	c.color_fg_error = color_from_cfg(config_get_int(user, "Accessibility", "MixerRedActive"));
 
+	c.generation++;
+
 	obs_enter_graphics();
 	gcfg = c;
 	obs_leave_graphics();
@@ -98,6 +109,55 @@ static void gcfg_inc_defer_ui(void *data)
 	}
 }
 
+static gs_vertbuffer_t *create_label_vbuf(uint32_t height)
+{
+	const uint32_t n = N_LABELS * 6;
+	struct gs_vb_data *vdata = gs_vbdata_create();
+	vdata->num = n;
+	vdata->points = bzalloc(sizeof(struct vec3) * n);
+	vdata->num_tex = 1;
+	vdata->tvarray = bzalloc(sizeof(struct gs_tvertarray));
+	vdata->tvarray[0].width = 2;
+	vdata->tvarray[0].array = bzalloc(sizeof(struct vec2) * n);
+
+	struct vec2 *tvarray = vdata->tvarray[0].array;
+	float label_cx = (float)label_image.cx;
+	float label_cy = (float)(label_image.cy / N_LABELS);
+
+	for (int i = 0; i < N_LABELS; i++) {
+		float y = height * i / (float)(N_LABELS - 1) - label_cy * 0.5f;
+		set_v3_rect(vdata->points + i * 6, 0.0f, y, label_cx, label_cy);
+		set_v2_uv(tvarray + i * 6, 0.0f, i / (float)N_LABELS, 1.f, (i + 1) / (float)N_LABELS);
+	}
+
+	return gs_vertexbuffer_create(vdata, 0);
+}
+
+gs_vertbuffer_t *label_vbuf_get(uint32_t height)
+{
+	ASSERT_GRAPHICS_CONTEXT();
+
+	if (!label_image.texture)
+		return NULL;
+
+	if (label_vbuf && label_vbuf_height == height && label_vbuf_cx == label_image.cx &&
+	    label_vbuf_cy == label_image.cy)
+		return label_vbuf;
+
+	if (label_image.cx != LABEL_IMAGE_WIDTH)
+		blog(LOG_WARNING, "Expected label image width %d, got %" PRIu32, LABEL_IMAGE_WIDTH, label_image.cx);
+
+	gs_vertexbuffer_destroy(label_vbuf);
+	label_vbuf = create_label_vbuf(height);
+	if (!label_vbuf)
+		blog(LOG_ERROR, "Failed to create vbuf");
+
+	label_vbuf_height = height;
+	label_vbuf_cx = label_image.cx;
+	label_vbuf_cy = label_image.cy;
+	return label_vbuf;
+}
+
 void gcfg_inc()
 {
 	if (os_atomic_inc_long(&refcnt) == 1)
@@ -113,6 +173,8 @@ static void gcfg_dec_defer_ui(void *data)
 	blog(LOG_DEBUG, "Releasing image file '" LABEL_IMAGE_FILE_NAME "'...");
 	obs_enter_graphics();
 	gs_image_file_free(&label_image);
+	gs_vertexbuffer_destroy(label_vbuf);
+	label_vbuf = NULL;
 	obs_leave_graphics();
 }
 
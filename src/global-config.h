@@ -1,6 +1,7 @@
 #pragma once
 #include <obs.h>
 #include <graphics/image-file.h>
+#include "volmeter.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -9,7 +10,7 @@ extern "C" {
 struct global_config_s
 {
 	float peak_decay_rate;
-	enum obs_peak_meter_type peak_meter_type;
+	enum volmeter_peak_type peak_meter_type;
 
 	bool override_colors;
 	uint32_t color_bg_nominal;
@@ -18,6 +19,9 @@ struct global_config_s
 	uint32_t color_fg_nominal;
 	uint32_t color_fg_warning;
 	uint32_t color_fg_error;
+
+	// incremented when any of the above is updated
+	uint32_t generation;
 };
 
 extern struct global_config_s gcfg;
@@ -26,6 +30,14 @@ void gcfg_dec();
 
 extern gs_image_file_t label_image;
 
+#define LABEL_IMAGE_WIDTH 48
+#define N_LABELS 13
+
+/* Returns the vertex buffer of the labels for the meter of `height`, shared by
+ * all the sources. Returns NULL if the label image is not loaded.
+ * Need to be in the graphics context. */
+gs_vertbuffer_t *label_vbuf_get(uint32_t height);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,76 +1,230 @@
+#include <stdio.h>
 #include <inttypes.h>
 #include <obs-module.h>
 #include <util/platform.h>
 #include <util/threading.h>
 #include <graphics/matrix4.h>
+#include <graphics/vec4.h>
+#include <media-io/audio-math.h>
 #include "plugin-macros.generated.h"
 #include "volmeter.h"
+#include "shared-volmeter.h"
+#include "level-history.h"
+#include "ballistics.h"
 #include "global-config.h"
 #include "util.h"
 
-#define AGE_THRESHOLD 0.05f      // [s]
-#define CLIP_FLASH_DURATION 1.0f // [s]
+#define AGE_THRESHOLD 0.05f        // [s]
+#define CLIP_FLASH_DURATION 1.0f   // [s]
+#define SOURCE_RETRY_INTERVAL 1.0f // [s]
 
 #define DISPLAY_WIDTH_PER_CHANNEL 16
 #define DISPLAY_HEIGHT_PER_DB 8
 #define DISPLAY_PADDING 16
 #define DISPLAY_CHANNEL_SPACING 4
-#define LABEL_IMAGE_WIDTH 48
-#define N_LABELS 13
+#define DISPLAY_METER_SPACING 12
+
+/* Momentary, short-term and integrated loudness are drawn right to the labels
+ * in the same scale as the channels, colored around the target of EBU R128. */
+#define N_LOUDNESS_BARS 3
+#define LOUDNESS_TARGET (-23.0f) // [LUFS]
+#define LOUDNESS_TOLERANCE 1.0f   // [LU]
+
+/* One column of the history is drawn in one pixel. Empty columns and
+ * silence are drawn at the bottom. */
+#define GRAPH_WIDTH LEVEL_HISTORY_COLUMNS
+#define GRAPH_DB_FLOOR (-1000.0f)
+
+/* The background, the channels and the loudness of all the meters are drawn
+ * as quads of one vertex buffer by one draw call. */
+#define N_BAR_QUADS(nr_meters) (1 + (nr_meters) * (MAX_AUDIO_CHANNELS + N_LOUDNESS_BARS))
+
+/* What is drawn, quantized to the pixels. The cached image is redrawn only if
+ * this is changed. */
+struct render_state_s
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t nr_meters;
+	int32_t bars[MAX_METERS][MAX_AUDIO_CHANNELS + N_LOUDNESS_BARS][4]; // mag, peak, peak_hold, clip_flash
+	uint64_t graph_count[MAX_METERS];
+	bool has_labels;
+};
+
+enum render_mode {
+	RENDER_MODE_METER = 0,
+	RENDER_MODE_GRAPH = 1,
+};
+
+/* Stages of the source whose time is recorded. */
+enum source_stage {
+	SOURCE_STAGE_VOLUME_CB, // thread: audio or source, see `volume_cb`
+	SOURCE_STAGE_TICK,
+	SOURCE_STAGE_RENDER,
+	SOURCE_STAGE_REDRAW, // drawing into the cached image, included in render
+	SOURCE_NR_STAGES,
+};
+
+static const char *source_stage_names[SOURCE_NR_STAGES] = {
+	"volume_cb",
+	"tick",
+	"render",
+	"redraw",
+};
 
 static inline float clamp_flt(float x, float min, float max)
 {
 	return fminf(fmaxf(x, min), max);
 }
 
-struct channel_volume_s
+/* Levels accumulated over the audio packets since the graphics thread took
+ * the last snapshot. */
+struct volume_snapshot_s
+{
+	uint32_t nr_channels;
+	uint64_t nr_frames;
+	float sum_squares[MAX_AUDIO_CHANNELS];
+	float peak[MAX_AUDIO_CHANNELS]; // linear scale
+	float packet_peak_min;          // minimum of the peaks of the packets over the channels
+	bool has_loudness;
+	struct loudness_values_s loudness; // latest one
+};
+
+/* Set to `snapshot_middle` when the audio thread has written a new snapshot
+ * that has not been taken by the graphics thread yet. */
+#define SNAPSHOT_DIRTY 4
+
+/* Parameters of `volmeter.effect`, resolved when the effect is created. */
+struct effect_params_s
 {
-	float display_magnitude;
-	float display_peak;
-	float peak_hold;
-	float peak_hold_age;
-	bool clip_flash;
-	float clip_flash_age;
+	gs_eparam_t *warning;
+	gs_eparam_t *error;
+	gs_eparam_t *color_bg_nominal;
+	gs_eparam_t *color_bg_warning;
+	gs_eparam_t *color_bg_error;
+	gs_eparam_t *color_fg_nominal;
+	gs_eparam_t *color_fg_warning;
+	gs_eparam_t *color_fg_error;
+	gs_eparam_t *graph;
+	gs_eparam_t *graph_columns;
+	gs_eparam_t *graph_offset;
+};
+
+struct source_s;
+
+/* One meter of a track or a source. */
+struct meter_s
+{
+	struct source_s *parent;
+
+	// properties
+	int track;
+	char *source_name; // metering the source instead of `track` if not empty
+
+	volmeter_t *volmeter;
+	obs_weak_source_t *volmeter_source; // source in the key of `volmeter`, borrowed
+
+	/* Resolved from `source_name`. Retried in `tick` while the source is
+	 * not found, such as before it is loaded. */
+	obs_weak_source_t *source;
+	float source_retry_age;
+
+	// thread: graphics
+	uint32_t nr_channels;
+
+	/* Triple buffer to pass magnitude and peak values from the audio
+	 * thread to the graphics thread without blocking each other.
+	 * The audio thread takes the middle one by swapping it with
+	 * `snapshot_back`, accumulates the levels into it, and puts it back
+	 * with the dirty flag. The graphics thread swaps `snapshot_front` with
+	 * `snapshot_middle` if it is dirty, then reads `snapshots[snapshot_front]`. */
+	struct volume_snapshot_s snapshots[3];
+	volatile long snapshot_middle;
+	long snapshot_back;  // thread: audio or source, see `volume_cb`
+	long snapshot_front; // thread: graphics
+
+	// last updated time information
+	float current_volume_age;
+
+	// thread: graphics
+	uint32_t first_channel;       // in `ballistics` of the parent
+	uint32_t ballistics_channels; // number of the channels in `ballistics`
+	struct loudness_values_s loudness_values;
+
+	/* History for the graph, only in the graph mode. `graph_data` is the
+	 * copy of the last columns of `graph_level` in dB, in the same ring
+	 * order as the history, so that only the new columns are converted. */
+	level_history_t *history;
+	enum level_history_level graph_level;
+	uint64_t graph_count;
+
+	/* While the audio is not coming, silence is appended to the history
+	 * by the time of the video so that the graph keeps scrolling. */
+	uint32_t history_sample_rate;
+	double history_silent_frames; // fraction not appended yet
+	bool history_silent;
+	struct vec4 graph_data[GRAPH_WIDTH]; // peak_min, peak_max, RMS, loudness
+	bool graph_dirty;
+	gs_texture_t *graph_texture;
 };
 
 struct source_s
 {
 	obs_source_t *context;
 	gs_effect_t *effect;
+	struct effect_params_s params;
+
+	/* The cached image is redrawn when the settings or `gcfg` are
+	 * updated. */
+	bool render_dirty;
+	uint32_t render_gcfg_generation;
 
 	// properties
-	int track;
 	float magnitude_attack_rate;
 	float magnitude_min;
 	float peak_decay_rate;
 	float peak_hold_duration;
 	bool peak_decay_rate_default;
-	enum obs_peak_meter_type peak_meter_type;
+	enum volmeter_peak_type peak_meter_type;
 	bool peak_meter_type_default;
+	bool loudness;
+	int update_rate; // [Hz], 0 for every packet, -1 for the video FPS
+	unsigned int update_ms;
+	enum render_mode render_mode;
+
+	/* Drawn from the left. Each meter is allocated separately since the
+	 * audio thread refers to it. Changed only by the graphics thread,
+	 * holding `meters_mutex` so that the procedures can read them
+	 * from any thread. */
+	pthread_mutex_t meters_mutex;
+	struct meter_s *meters[MAX_METERS];
+	uint32_t nr_meters;
+
+	// thread: graphics, the channels of all the meters, packed
+	struct ballistics_s ballistics;
+
+	// thread: graphics, cached for `get_width` and `get_height`
+	uint32_t width;
+	uint32_t height;
 
-	// internal data
-	// thread: audio
-	volmeter_t *volmeter;
-	DARRAY(uint8_t) buffer;
+	// thread: graphics
+	gs_vertbuffer_t *bars_vbuf;
+	uint32_t bars_vbuf_meters;
 
-	// magnitude and peak values written by audio thread
-	pthread_mutex_t mutex;
-	float current_magnitude[MAX_AUDIO_CHANNELS];
-	float current_peak[MAX_AUDIO_CHANNELS];
+	gs_texrender_t *texrender;
+	struct render_state_s render_state;
+	bool render_cached;
 
-	// last updated time information
-	bool current_volume_updated;
-	float current_volume_age;
+	/* Set if `gs_texrender_begin` failed for the size, such as exceeding
+	 * the maximum texture size. Drawn directly until the size changes. */
+	bool texrender_failed;
+	uint32_t texrender_failed_width;
+	uint32_t texrender_failed_height;
 
-	// internal data
-	// thread: graphics
-	struct channel_volume_s volumes[MAX_AUDIO_CHANNELS];
-	gs_vertbuffer_t *label_vbuf;
+	struct latency_stats_s latency[SOURCE_NR_STAGES];
 };
 
-static void audio_cb(void *param, size_t mix_idx, struct audio_data *data);
-static void volume_cb(void *param, const float magnitude[MAX_AUDIO_CHANNELS], const float peak[MAX_AUDIO_CHANNELS],
-		      const float input_peak[MAX_AUDIO_CHANNELS]);
+static void volume_cb(void *param, const struct volmeter_levels_s *levels);
 
 static const char *get_name(void *type_data)
 {
@@ -78,13 +232,120 @@ static const char *get_name(void *type_data)
 	return obs_module_text("GraphicalVolMeter.Source.Name");
 }
 
+/* The properties of the first meter keep the names before the bank mode. */
+static void get_meter_prop_name(char *name, size_t size, const char *prefix, uint32_t i)
+{
+	if (i == 0)
+		snprintf(name, size, "%s", prefix);
+	else
+		snprintf(name, size, "%s_%" PRIu32, prefix, i + 1);
+}
+
+static void get_meter_prop_text(char *text, size_t size, const char *lookup, uint32_t i)
+{
+	if (i == 0)
+		snprintf(text, size, "%s", obs_module_text(lookup));
+	else
+		snprintf(text, size, "%s %" PRIu32, obs_module_text(lookup), i + 1);
+}
+
+static bool add_audio_source(void *data, obs_source_t *source)
+{
+	obs_property_t *prop = data;
+	if (obs_source_get_output_flags(source) & OBS_SOURCE_AUDIO) {
+		const char *name = obs_source_get_name(source);
+		obs_property_list_add_string(prop, name, name);
+	}
+	return true;
+}
+
+/* The sources are enumerated once into the list of the first meter and copied
+ * to the other meters only when they are shown. */
+static void copy_source_list(obs_properties_t *props, uint32_t i)
+{
+	char name[32];
+	get_meter_prop_name(name, sizeof(name), "source", i);
+	obs_property_t *dst = obs_properties_get(props, name);
+	obs_property_t *src = obs_properties_get(props, "source");
+	if (!dst || !src || dst == src || obs_property_list_item_count(dst) > 1)
+		return;
+
+	// The first item is the track.
+	size_t count = obs_property_list_item_count(src);
+	for (size_t j = 1; j < count; j++)
+		obs_property_list_add_string(dst, obs_property_list_item_name(src, j),
+					     obs_property_list_item_string(src, j));
+}
+
+static bool meters_modified(obs_properties_t *props, obs_property_t *prop, obs_data_t *settings)
+{
+	UNUSED_PARAMETER(prop);
+	uint32_t nr_meters = (uint32_t)obs_data_get_int(settings, "nr_meters");
+
+	for (uint32_t i = 0; i < MAX_METERS; i++) {
+		char name[32];
+		get_meter_prop_name(name, sizeof(name), "source", i);
+		const char *source_name = obs_data_get_string(settings, name);
+		obs_property_set_visible(obs_properties_get(props, name), i < nr_meters);
+		if (i < nr_meters)
+			copy_source_list(props, i);
+
+		get_meter_prop_name(name, sizeof(name), "track", i);
+		obs_property_set_visible(obs_properties_get(props, name),
+					 i < nr_meters && (!source_name || !*source_name));
+	}
+	return true;
+}
+
+/* The volmeters are shared, so the other sources metering the same audio
+ * with the same settings are also reset. Callable from any thread. */
+static void reset_loudness(struct source_s *s)
+{
+	pthread_mutex_lock(&s->meters_mutex);
+	for (uint32_t i = 0; i < s->nr_meters; i++) {
+		if (s->meters[i]->volmeter)
+			volmeter_reset_loudness(s->meters[i]->volmeter);
+	}
+	pthread_mutex_unlock(&s->meters_mutex);
+}
+
+static bool reset_loudness_clicked(obs_properties_t *props, obs_property_t *property, void *data)
+{
+	UNUSED_PARAMETER(props);
+	UNUSED_PARAMETER(property);
+	reset_loudness(data);
+	return false;
+}
+
 static obs_properties_t *get_properties(void *data)
 {
-	UNUSED_PARAMETER(data);
+	struct source_s *s = data;
 	obs_properties_t *props = obs_properties_create();
 	obs_property_t *prop;
 
-	obs_properties_add_int(props, "track", obs_module_text("Prop.Track"), 1, MAX_AUDIO_MIXES, 1);
+	prop = obs_properties_add_int(props, "nr_meters", obs_module_text("Prop.NrMeters"), 1, MAX_METERS, 1);
+	obs_property_set_modified_callback(prop, meters_modified);
+
+	for (uint32_t i = 0; i < MAX_METERS; i++) {
+		char name[32], text[64];
+
+		get_meter_prop_name(name, sizeof(name), "source", i);
+		get_meter_prop_text(text, sizeof(text), "Prop.Source", i);
+		prop = obs_properties_add_list(props, name, text, OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+		obs_property_list_add_string(prop, obs_module_text("Prop.Source.Track"), "");
+		obs_property_set_modified_callback(prop, meters_modified);
+		if (i == 0)
+			obs_enum_sources(add_audio_source, prop);
+
+		get_meter_prop_name(name, sizeof(name), "track", i);
+		get_meter_prop_text(text, sizeof(text), "Prop.Track", i);
+		obs_properties_add_int(props, name, text, 1, MAX_AUDIO_MIXES, 1);
+	}
+	if (s) {
+		obs_data_t *settings = obs_source_get_settings(s->context);
+		meters_modified(props, NULL, settings);
+		obs_data_release(settings);
+	}
 
 	prop = obs_properties_add_list(props, "peak_decay_rate", obs_module_text("Prop.PeakDecayRate"),
 				       OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_FLOAT);
@@ -98,25 +359,325 @@ static obs_properties_t *get_properties(void *data)
 	obs_property_list_add_int(prop, obs_module_text("Prop.PeakMeterType.Default"), -1);
 	obs_property_list_add_int(prop, obs_module_text("Prop.PeakMeterType.SamplePeak"), 0);
 	obs_property_list_add_int(prop, obs_module_text("Prop.PeakMeterType.TruePeak"), 1);
+	obs_property_list_add_int(prop, obs_module_text("Prop.PeakMeterType.TruePeak4x"), 2);
+	obs_property_list_add_int(prop, obs_module_text("Prop.PeakMeterType.TruePeak8x"), 3);
+
+	obs_properties_add_bool(props, "loudness", obs_module_text("Prop.Loudness"));
+	obs_properties_add_button(props, "reset_loudness", obs_module_text("Prop.ResetLoudness"),
+				  reset_loudness_clicked);
+
+	prop = obs_properties_add_list(props, "update_rate", obs_module_text("Prop.UpdateRate"), OBS_COMBO_TYPE_LIST,
+				       OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(prop, obs_module_text("Prop.UpdateRate.EveryPacket"), 0);
+	obs_property_list_add_int(prop, obs_module_text("Prop.UpdateRate.VideoFPS"), -1);
+	obs_property_list_add_int(prop, obs_module_text("Prop.UpdateRate.60Hz"), 60);
+	obs_property_list_add_int(prop, obs_module_text("Prop.UpdateRate.30Hz"), 30);
+	obs_property_list_add_int(prop, obs_module_text("Prop.UpdateRate.10Hz"), 10);
+
+	prop = obs_properties_add_list(props, "render_mode", obs_module_text("Prop.RenderMode"), OBS_COMBO_TYPE_LIST,
+				       OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(prop, obs_module_text("Prop.RenderMode.Meter"), RENDER_MODE_METER);
+	obs_property_list_add_int(prop, obs_module_text("Prop.RenderMode.Graph"), RENDER_MODE_GRAPH);
+
+	prop = obs_properties_add_list(props, "graph_level", obs_module_text("Prop.GraphLevel"), OBS_COMBO_TYPE_LIST,
+				       OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(prop, obs_module_text("Prop.GraphLevel.100ms"), LEVEL_HISTORY_100MS);
+	obs_property_list_add_int(prop, obs_module_text("Prop.GraphLevel.1s"), LEVEL_HISTORY_1S);
+	obs_property_list_add_int(prop, obs_module_text("Prop.GraphLevel.10s"), LEVEL_HISTORY_10S);
+	obs_property_list_add_int(prop, obs_module_text("Prop.GraphLevel.1min"), LEVEL_HISTORY_1MIN);
 
 	return props;
 }
 
 static void get_defaults(obs_data_t *settings)
 {
-	obs_data_set_default_int(settings, "track", 1);
+	obs_data_set_default_int(settings, "nr_meters", 1);
+	for (uint32_t i = 0; i < MAX_METERS; i++) {
+		char name[32];
+		get_meter_prop_name(name, sizeof(name), "source", i);
+		obs_data_set_default_string(settings, name, "");
+		get_meter_prop_name(name, sizeof(name), "track", i);
+		obs_data_set_default_int(settings, name, i < MAX_AUDIO_MIXES ? i + 1 : 1);
+	}
 	obs_data_set_default_int(settings, "peak_meter_type", -1);
+	obs_data_set_default_int(settings, "update_rate", 0);
+	obs_data_set_default_int(settings, "render_mode", RENDER_MODE_METER);
+	obs_data_set_default_int(settings, "graph_level", LEVEL_HISTORY_100MS);
 }
 
-static void update_internal(struct source_s *s, obs_data_t *settings)
+static void subscribe_volmeter(struct meter_s *m, const struct shared_volmeter_key_s *key)
 {
-	int track = (int)obs_data_get_int(settings, "track") - 1;
-	if (track != s->track && 0 <= track && track < MAX_AUDIO_MIXES) {
-		obs_remove_raw_audio_callback(s->track, audio_cb, s);
-		obs_add_raw_audio_callback(track, NULL, audio_cb, s);
-		s->track = track;
+	if (m->volmeter && key->track == m->track && key->source == m->volmeter_source &&
+	    key->peak_meter_type == m->parent->peak_meter_type && key->loudness == m->parent->loudness &&
+	    key->update_ms == m->parent->update_ms)
+		return;
+
+	/* Don't fall back to the track while the source is not found. */
+	bool has_source = m->source_name && *m->source_name;
+
+	/* Get the new one before releasing the old one so that the shared
+	 * volmeter is not recreated if another source still uses it. */
+	volmeter_t *volmeter = has_source && !key->source ? NULL : shared_volmeter_get(key);
+
+	pthread_mutex_lock(&m->parent->meters_mutex);
+	volmeter_t *prev = m->volmeter;
+	m->volmeter = volmeter;
+	pthread_mutex_unlock(&m->parent->meters_mutex);
+
+	if (prev) {
+		volmeter_remove_callback(prev, volume_cb, m);
+		shared_volmeter_release(prev);
+	}
+
+	m->volmeter_source = volmeter ? key->source : NULL;
+	m->track = key->track;
+
+	if (volmeter)
+		volmeter_add_callback(volmeter, volume_cb, m);
+}
+
+static void resolve_source(struct meter_s *m)
+{
+	obs_weak_source_release(m->source);
+	m->source = NULL;
+	m->source_retry_age = 0.0f;
+
+	if (!m->source_name || !*m->source_name)
+		return;
+
+	obs_source_t *source = obs_get_source_by_name(m->source_name);
+	if (source && source != m->parent->context)
+		m->source = obs_source_get_weak_source(source);
+	obs_source_release(source);
+}
+
+static void get_volmeter_key(const struct meter_s *m, struct shared_volmeter_key_s *key)
+{
+	key->track = m->track;
+	key->source = m->source;
+	key->peak_meter_type = m->parent->peak_meter_type;
+	key->loudness = m->parent->loudness;
+	key->update_ms = m->parent->update_ms;
+}
+
+/* Subscribes the volmeters again after the shared settings are changed. The
+ * previous settings are taken from the keys so that `subscribe_volmeter` can
+ * compare them. */
+static void subscribe_volmeters(struct source_s *s, enum volmeter_peak_type peak_meter_type, bool loudness,
+				unsigned int update_ms)
+{
+	for (uint32_t i = 0; i < s->nr_meters; i++) {
+		struct meter_s *m = s->meters[i];
+		struct shared_volmeter_key_s key;
+		get_volmeter_key(m, &key);
+		key.peak_meter_type = peak_meter_type;
+		key.loudness = loudness;
+		key.update_ms = update_ms;
+		subscribe_volmeter(m, &key);
 	}
 
+	s->peak_meter_type = peak_meter_type;
+	s->loudness = loudness;
+	s->update_ms = update_ms;
+}
+
+static inline float graph_db(float db)
+{
+	return isnan(db) || db < GRAPH_DB_FLOOR ? GRAPH_DB_FLOOR : db;
+}
+
+/* Converts the columns appended since the last call. */
+static void update_graph_data(struct meter_s *m)
+{
+	uint64_t count = level_history_get_count(m->history, m->graph_level);
+	if (count == m->graph_count)
+		return;
+
+	if (count - m->graph_count > GRAPH_WIDTH)
+		m->graph_count = count - GRAPH_WIDTH;
+
+	for (uint64_t i = m->graph_count; i < count; i++) {
+		struct level_history_column_s c;
+		if (!level_history_get_column(m->history, m->graph_level, i, &c))
+			continue;
+
+		float rms = c.nr_samples ? (float)sqrt(c.sum_squares / c.nr_samples) : 0.0f;
+		vec4_set(&m->graph_data[i % GRAPH_WIDTH], graph_db(mul_to_db(c.peak_min)),
+			 graph_db(mul_to_db(c.peak_max)), graph_db(mul_to_db(rms)), graph_db(c.loudness));
+	}
+
+	m->graph_count = count;
+	m->graph_dirty = true;
+}
+
+static void reset_graph_data(struct meter_s *m)
+{
+	for (int i = 0; i < GRAPH_WIDTH; i++)
+		vec4_set(&m->graph_data[i], GRAPH_DB_FLOOR, GRAPH_DB_FLOOR, GRAPH_DB_FLOOR, GRAPH_DB_FLOOR);
+
+	uint64_t count = level_history_get_count(m->history, m->graph_level);
+	m->graph_count = count > GRAPH_WIDTH ? count - GRAPH_WIDTH : 0;
+	update_graph_data(m);
+	m->graph_dirty = true;
+}
+
+static void update_history(struct meter_s *m, enum render_mode render_mode, enum level_history_level graph_level)
+{
+	if (render_mode != RENDER_MODE_GRAPH) {
+		level_history_destroy(m->history);
+		m->history = NULL;
+		return;
+	}
+
+	if (!m->history) {
+		struct obs_audio_info audio_info;
+		if (obs_get_audio_info(&audio_info))
+			m->history = level_history_create(audio_info.samples_per_sec);
+		if (!m->history) {
+			blog(LOG_ERROR, "Failed to create level history");
+			return;
+		}
+		m->history_sample_rate = audio_info.samples_per_sec;
+		m->history_silent_frames = 0.0;
+	}
+	else if (graph_level == m->graph_level) {
+		return;
+	}
+
+	m->graph_level = graph_level;
+	reset_graph_data(m);
+}
+
+/* Width of the channels or the graph of one meter. */
+static uint32_t get_meter_width(const struct source_s *s, const struct meter_s *m)
+{
+	if (s->render_mode == RENDER_MODE_GRAPH)
+		return GRAPH_WIDTH;
+	return (DISPLAY_WIDTH_PER_CHANNEL + DISPLAY_CHANNEL_SPACING) * m->nr_channels - DISPLAY_CHANNEL_SPACING;
+}
+
+/* Width of all the meters, left to the labels. */
+static uint32_t get_meters_width(const struct source_s *s)
+{
+	uint32_t width = 0;
+	for (uint32_t i = 0; i < s->nr_meters; i++)
+		width += get_meter_width(s, s->meters[i]) + (i ? DISPLAY_METER_SPACING : 0);
+	return width;
+}
+
+/* Width of the loudness bars of one meter, including the spacing at the left. */
+#define LOUDNESS_BARS_WIDTH ((DISPLAY_WIDTH_PER_CHANNEL + DISPLAY_CHANNEL_SPACING) * N_LOUDNESS_BARS)
+
+static void update_size(struct source_s *s)
+{
+	uint32_t width = get_meters_width(s) + LABEL_IMAGE_WIDTH + DISPLAY_PADDING * 2;
+	if (s->loudness && s->nr_meters)
+		width += (LOUDNESS_BARS_WIDTH + DISPLAY_METER_SPACING) * s->nr_meters - DISPLAY_METER_SPACING;
+
+	s->width = width;
+	s->height = DISPLAY_HEIGHT_PER_DB * (uint32_t)-s->magnitude_min + DISPLAY_PADDING * 2;
+}
+
+/* Packs the channels of the meters into `ballistics`. A meter whose channels
+ * are moved or resized starts from the initial state. */
+static void layout_ballistics(struct source_s *s)
+{
+	struct ballistics_s *b = &s->ballistics;
+	uint32_t first = 0;
+
+	for (uint32_t i = 0; i < s->nr_meters; i++) {
+		struct meter_s *m = s->meters[i];
+		uint32_t count = m->nr_channels < MAX_AUDIO_CHANNELS ? m->nr_channels : MAX_AUDIO_CHANNELS;
+		if (m->first_channel != first || m->ballistics_channels != count) {
+			ballistics_reset(b, first, count);
+			m->first_channel = first;
+			m->ballistics_channels = count;
+		}
+		first += count;
+	}
+
+	ballistics_reset(b, first, ((first + 3) & ~3u) - first);
+	b->nr_channels = first;
+}
+
+static unsigned int get_update_ms(int update_rate)
+{
+	if (update_rate > 0)
+		return 1000 / (unsigned int)update_rate;
+
+	if (update_rate == -1) {
+		struct obs_video_info ovi;
+		if (obs_get_video_info(&ovi) && ovi.fps_num > 0)
+			return (unsigned int)((uint64_t)ovi.fps_den * 1000 / ovi.fps_num);
+	}
+
+	return 0;
+}
+
+static struct meter_s *meter_create(struct source_s *s)
+{
+	struct meter_s *m = bzalloc(sizeof(struct meter_s));
+	m->parent = s;
+	m->track = -1;
+
+	m->current_volume_age = M_INFINITE;
+
+	m->snapshot_front = 0;
+	m->snapshot_middle = 1;
+	m->snapshot_back = 2;
+
+	m->loudness_values.momentary = -M_INFINITE;
+	m->loudness_values.short_term = -M_INFINITE;
+	m->loudness_values.integrated = -M_INFINITE;
+
+	return m;
+}
+
+static void meter_destroy(struct meter_s *m)
+{
+	if (m->graph_texture) {
+		obs_enter_graphics();
+		gs_texture_destroy(m->graph_texture);
+		obs_leave_graphics();
+	}
+
+	level_history_destroy(m->history);
+
+	if (m->volmeter) {
+		volmeter_remove_callback(m->volmeter, volume_cb, m);
+		shared_volmeter_release(m->volmeter);
+	}
+
+	obs_weak_source_release(m->source);
+	bfree(m->source_name);
+	bfree(m);
+}
+
+static void update_meter(struct meter_s *m, obs_data_t *settings, uint32_t i)
+{
+	char name[32];
+	struct shared_volmeter_key_s key;
+	get_volmeter_key(m, &key);
+
+	get_meter_prop_name(name, sizeof(name), "track", i);
+	int track = (int)obs_data_get_int(settings, name) - 1;
+	if (0 <= track && track < MAX_AUDIO_MIXES)
+		key.track = track;
+
+	get_meter_prop_name(name, sizeof(name), "source", i);
+	const char *source_name = obs_data_get_string(settings, name);
+	if (!m->source_name || strcmp(source_name, m->source_name) != 0) {
+		bfree(m->source_name);
+		m->source_name = bstrdup(source_name);
+		resolve_source(m);
+		key.source = m->source;
+	}
+
+	subscribe_volmeter(m, &key);
+}
+
+static void update_internal(struct source_s *s, obs_data_t *settings)
+{
 	double peak_decay_rate = obs_data_get_double(settings, "peak_decay_rate");
 	if (peak_decay_rate <= 0.0) {
 		s->peak_decay_rate_default = true;
@@ -126,16 +687,59 @@ static void update_internal(struct source_s *s, obs_data_t *settings)
 		s->peak_decay_rate = (float)peak_decay_rate;
 	}
 
-	int peak_meter_type = (int)obs_data_get_int(settings, "peak_meter_type");
-	if (peak_meter_type == -1) {
+	enum volmeter_peak_type peak_meter_type;
+	int peak_meter_type_int = (int)obs_data_get_int(settings, "peak_meter_type");
+	if (peak_meter_type_int == -1) {
 		s->peak_meter_type_default = true;
-		s->peak_meter_type = gcfg.peak_meter_type;
+		peak_meter_type = gcfg.peak_meter_type;
 	}
 	else {
 		s->peak_meter_type_default = false;
-		s->peak_meter_type = peak_meter_type_from_int(peak_meter_type);
+		peak_meter_type = peak_meter_type_from_int(peak_meter_type_int);
+	}
+
+	bool loudness = obs_data_get_bool(settings, "loudness");
+
+	s->update_rate = (int)obs_data_get_int(settings, "update_rate");
+
+	long long nr_meters = obs_data_get_int(settings, "nr_meters");
+	if (nr_meters < 1)
+		nr_meters = 1;
+	else if (nr_meters > MAX_METERS)
+		nr_meters = MAX_METERS;
+
+	while (s->nr_meters > (uint32_t)nr_meters) {
+		pthread_mutex_lock(&s->meters_mutex);
+		struct meter_s *m = s->meters[--s->nr_meters];
+		pthread_mutex_unlock(&s->meters_mutex);
+		meter_destroy(m);
+	}
+	while (s->nr_meters < (uint32_t)nr_meters) {
+		struct meter_s *m = meter_create(s);
+		pthread_mutex_lock(&s->meters_mutex);
+		s->meters[s->nr_meters++] = m;
+		pthread_mutex_unlock(&s->meters_mutex);
+	}
+
+	/* New meters have no volmeter yet and are subscribed below. */
+	subscribe_volmeters(s, peak_meter_type, loudness, get_update_ms(s->update_rate));
+
+	s->render_mode = obs_data_get_int(settings, "render_mode") == RENDER_MODE_GRAPH ? RENDER_MODE_GRAPH
+											 : RENDER_MODE_METER;
+	int graph_level = (int)obs_data_get_int(settings, "graph_level");
+	if (graph_level < 0 || LEVEL_HISTORY_NR_LEVELS <= graph_level)
+		graph_level = LEVEL_HISTORY_100MS;
+
+	for (uint32_t i = 0; i < s->nr_meters; i++) {
+		struct meter_s *m = s->meters[i];
+		update_meter(m, settings, i);
+		update_history(m, s->render_mode, (enum level_history_level)graph_level);
+		m->nr_channels = volmeter_get_nr_channels(m->volmeter);
 	}
-	volmeter_set_peak_meter_type(s->volmeter, s->peak_meter_type);
+
+	s->render_dirty = true;
+	layout_ballistics(s);
+	update_size(s);
 }
 
 static void update(void *data, obs_data_t *settings)
@@ -144,114 +748,279 @@ static void update(void *data, obs_data_t *settings)
 	update_internal(data, settings);
 }
 
-static void *create(obs_data_t *settings, obs_source_t *source)
+static void get_effect_params(struct effect_params_s *p, gs_effect_t *effect)
 {
-	gcfg_inc();
+	p->warning = gs_effect_get_param_by_name(effect, "warning");
+	p->error = gs_effect_get_param_by_name(effect, "error");
+	p->color_bg_nominal = gs_effect_get_param_by_name(effect, "color_bg_nominal");
+	p->color_bg_warning = gs_effect_get_param_by_name(effect, "color_bg_warning");
+	p->color_bg_error = gs_effect_get_param_by_name(effect, "color_bg_error");
+	p->color_fg_nominal = gs_effect_get_param_by_name(effect, "color_fg_nominal");
+	p->color_fg_warning = gs_effect_get_param_by_name(effect, "color_fg_warning");
+	p->color_fg_error = gs_effect_get_param_by_name(effect, "color_fg_error");
+	p->graph = gs_effect_get_param_by_name(effect, "graph");
+	p->graph_columns = gs_effect_get_param_by_name(effect, "graph_columns");
+	p->graph_offset = gs_effect_get_param_by_name(effect, "graph_offset");
+}
 
-	struct source_s *s = bzalloc(sizeof(struct source_s));
-	s->context = source;
-	s->track = -1;
+/* Callable from any thread. The stats are read without locking but the
+ * volmeters are not replaced while reading them. */
+static void get_latency_stats_proc(void *param, calldata_t *cd)
+{
+	struct source_s *s = param;
+
+	obs_data_t *data = obs_data_create();
+	for (int i = 0; i < SOURCE_NR_STAGES; i++)
+		latency_stats_to_data(&s->latency[i], data, source_stage_names[i]);
+
+	obs_data_array_t *volmeters = obs_data_array_create();
+	pthread_mutex_lock(&s->meters_mutex);
+	for (uint32_t i = 0; i < s->nr_meters; i++) {
+		volmeter_t *volmeter = s->meters[i]->volmeter;
+		obs_data_t *vm = obs_data_create();
+		for (int j = 0; volmeter && j < VOLMETER_NR_STAGES; j++)
+			latency_stats_to_data(volmeter_get_latency_stats(volmeter, j), vm, volmeter_stage_name(j));
+		obs_data_array_push_back(volmeters, vm);
+		obs_data_release(vm);
+	}
+	pthread_mutex_unlock(&s->meters_mutex);
+	obs_data_set_array(data, "volmeters", volmeters);
+	obs_data_array_release(volmeters);
+
+	calldata_set_string(cd, "json", obs_data_get_json(data));
+	obs_data_release(data);
+}
+
+static void reset_loudness_proc(void *param, calldata_t *cd)
+{
+	UNUSED_PARAMETER(cd);
+	reset_loudness(param);
+}
+
+/* Follows the new name of a metered source since the settings refer to it by
+ * the name. Called by the thread renaming the source. The update is applied
+ * by the graphics thread, which then looks up the source by the new name. */
+static void source_renamed_cb(void *param, calldata_t *cd)
+{
+	struct source_s *s = param;
+	const char *prev_name = calldata_string(cd, "prev_name");
+	const char *new_name = calldata_string(cd, "new_name");
+	if (!prev_name || !*prev_name || !new_name)
+		return;
 
-	s->current_volume_age = M_INFINITE;
+	obs_data_t *settings = obs_source_get_settings(s->context);
+	obs_data_t *renamed = NULL;
+	for (uint32_t i = 0; i < MAX_METERS; i++) {
+		char name[32];
+		get_meter_prop_name(name, sizeof(name), "source", i);
+		if (strcmp(obs_data_get_string(settings, name), prev_name) != 0)
+			continue;
+		if (!renamed)
+			renamed = obs_data_create();
+		obs_data_set_string(renamed, name, new_name);
+	}
+	obs_data_release(settings);
 
-	for (uint32_t ch = 0; ch < MAX_AUDIO_CHANNELS; ch++) {
-		s->current_magnitude[ch] = -M_INFINITE;
-		s->current_peak[ch] = -M_INFINITE;
-		s->volumes[ch].display_magnitude = -M_INFINITE;
-		s->volumes[ch].display_peak = -M_INFINITE;
-		s->volumes[ch].peak_hold = -M_INFINITE;
+	if (renamed) {
+		obs_source_update(s->context, renamed);
+		obs_data_release(renamed);
 	}
+}
+
+static void log_latency_stats(struct source_s *s)
+{
+	const char *name = obs_source_get_name(s->context);
+	for (int i = 0; i < SOURCE_NR_STAGES; i++)
+		latency_stats_log(&s->latency[i], name, source_stage_names[i]);
+}
+
+static void *create(obs_data_t *settings, obs_source_t *source)
+{
+	struct source_s *s = bzalloc(sizeof(struct source_s));
+	if (pthread_mutex_init(&s->meters_mutex, NULL) != 0) {
+		blog(LOG_ERROR, "Failed to create mutex");
+		bfree(s);
+		return NULL;
+	}
+
+	gcfg_inc();
+
+	s->context = source;
 
 	obs_enter_graphics();
 	s->effect = create_effect_from_module_file("volmeter.effect");
+	if (s->effect)
+		get_effect_params(&s->params, s->effect);
 	obs_leave_graphics();
-
-	pthread_mutex_init(&s->mutex, NULL);
+	s->render_dirty = true;
 
 	s->magnitude_attack_rate = 0.99f / 0.3f;
 	s->magnitude_min = -60.0f;
 	s->peak_decay_rate = 20.0f / 0.85f; // [dB/s]
 	s->peak_hold_duration = 20.0f;      // [s]
 
-	s->volmeter = volmeter_create();
-	if (!s->volmeter)
-		goto fail;
-
 	update_internal(s, settings);
 
-	volmeter_add_callback(s->volmeter, volume_cb, s);
+	proc_handler_t *ph = obs_source_get_proc_handler(source);
+	proc_handler_add(ph, "void get_latency_stats(out string json)", get_latency_stats_proc, s);
+	proc_handler_add(ph, "void reset_loudness()", reset_loudness_proc, s);
 
-	return s;
+	signal_handler_connect(obs_get_signal_handler(), "source_rename", source_renamed_cb, s);
 
-fail:
-	bfree(s);
-	return NULL;
+	return s;
 }
 
 static void destroy(void *data)
 {
 	struct source_s *s = data;
 
+	signal_handler_disconnect(obs_get_signal_handler(), "source_rename", source_renamed_cb, s);
+
 	gcfg_dec();
 
-	if (s->label_vbuf) {
+	log_latency_stats(s);
+
+	if (s->bars_vbuf || s->texrender) {
 		obs_enter_graphics();
-		gs_vertexbuffer_destroy(s->label_vbuf);
+		gs_texrender_destroy(s->texrender);
+		gs_vertexbuffer_destroy(s->bars_vbuf);
 		obs_leave_graphics();
 	}
 
-	if (s->track >= 0)
-		obs_remove_raw_audio_callback(s->track, audio_cb, s);
+	for (uint32_t i = 0; i < s->nr_meters; i++)
+		meter_destroy(s->meters[i]);
 
-	volmeter_remove_callback(s->volmeter, volume_cb, s);
-	volmeter_destroy(s->volmeter);
+	pthread_mutex_destroy(&s->meters_mutex);
+	bfree(s);
+}
 
-	pthread_mutex_destroy(&s->mutex);
+static void tick_history(struct meter_s *m, const struct volume_snapshot_s *snapshot)
+{
+	struct level_history_column_s c = {
+		.peak_min = snapshot->packet_peak_min,
+		.peak_max = 0.0f,
+		.sum_squares = 0.0,
+		.nr_samples = snapshot->nr_frames * snapshot->nr_channels,
+		.loudness = snapshot->has_loudness ? snapshot->loudness.momentary : -M_INFINITE,
+	};
+	for (uint32_t ch = 0; ch < snapshot->nr_channels; ch++) {
+		c.peak_max = fmaxf(c.peak_max, snapshot->peak[ch]);
+		c.sum_squares += snapshot->sum_squares[ch];
+	}
 
-	da_free(s->buffer);
+	level_history_add(m->history, &c, snapshot->nr_frames);
+	update_graph_data(m);
+}
 
-	bfree(s);
+static void tick_history_silence(struct meter_s *m, float duration)
+{
+	m->history_silent_frames += (double)duration * m->history_sample_rate;
+	uint64_t nr_frames = (uint64_t)m->history_silent_frames;
+	if (!nr_frames)
+		return;
+	m->history_silent_frames -= (double)nr_frames;
+
+	const struct level_history_column_s c = {
+		.peak_min = 0.0f,
+		.peak_max = 0.0f,
+		.sum_squares = 0.0,
+		.nr_samples = 0,
+		.loudness = -M_INFINITE,
+	};
+	level_history_add(m->history, &c, nr_frames);
+	update_graph_data(m);
 }
 
-static inline void tick_magnitude(const struct source_s *s, struct channel_volume_s *c, float mag, float duration)
+/* Looks up the source again if it has not been found or has been removed. */
+static void tick_source(struct meter_s *m, float duration)
 {
-	if (!isfinite(c->display_magnitude)) {
-		c->display_magnitude = mag;
-	}
-	else {
-		float attack = (mag - c->display_magnitude) * duration * s->magnitude_attack_rate;
-		c->display_magnitude = clamp_flt(c->display_magnitude + attack, s->magnitude_min, 0.0f);
-	}
+	if (!m->source_name || !*m->source_name)
+		return;
+
+	if (m->volmeter && !obs_weak_source_expired(m->volmeter_source))
+		return;
+
+	m->source_retry_age += duration;
+	if (m->source_retry_age < SOURCE_RETRY_INTERVAL)
+		return;
+
+	resolve_source(m);
+
+	struct shared_volmeter_key_s key;
+	get_volmeter_key(m, &key);
+	subscribe_volmeter(m, &key);
 }
 
-static inline void tick_peak(const struct source_s *s, struct channel_volume_s *c, float peak, float duration)
+/* Takes the snapshot and sets it as the input of the ballistics. */
+static void tick_meter(struct source_s *s, struct meter_s *m, float duration)
 {
-	if (peak >= c->display_peak || isnan(c->display_peak)) {
-		c->display_peak = peak;
+	bool updated = false;
+	long middle = os_atomic_load_long(&m->snapshot_middle);
+	/* If the audio thread is accumulating into the middle one, the dirty
+	 * flag is cleared and the snapshot will be taken at the next tick. */
+	if ((middle & SNAPSHOT_DIRTY) &&
+	    os_atomic_compare_swap_long(&m->snapshot_middle, middle, m->snapshot_front)) {
+		m->snapshot_front = middle & ~SNAPSHOT_DIRTY;
+		m->current_volume_age = 0;
+		updated = true;
 	}
-	else {
-		float peak_decay_rate = s->peak_decay_rate_default ? gcfg.peak_decay_rate : s->peak_decay_rate;
-		float decay = duration * peak_decay_rate;
-		c->display_peak = clamp_flt(c->display_peak - decay, peak, 0.0f);
+
+	const struct volume_snapshot_s *snapshot = &m->snapshots[m->snapshot_front];
+	uint32_t nr_channels = snapshot->nr_channels;
+
+	if (updated && m->history && nr_channels)
+		tick_history(m, snapshot);
+
+	/* The channels follow the audio data after the audio is reset. */
+	if (updated && nr_channels && nr_channels != m->nr_channels) {
+		m->nr_channels = nr_channels;
+		layout_ballistics(s);
+		update_size(s);
 	}
 
-	if (peak >= c->peak_hold || !isfinite(c->peak_hold) || c->peak_hold_age > s->peak_hold_duration) {
-		c->peak_hold = peak;
-		c->peak_hold_age = 0.0f;
+	if (!updated) {
+		/* Keep the levels until the next update is overdue. */
+		if (m->current_volume_age >= AGE_THRESHOLD + s->update_ms * 1e-3f) {
+			nr_channels = 0;
+			/* The first one also covers the time since the last update. */
+			float silence = m->history_silent ? duration : m->current_volume_age + duration;
+			if (m->history)
+				tick_history_silence(m, silence);
+			m->history_silent = true;
+		}
+		else {
+			m->current_volume_age += duration;
+		}
 	}
 	else {
-		c->peak_hold_age += duration;
+		m->history_silent = false;
+	}
+
+	/* Convert to dB only once per frame. */
+	float *current_magnitude = s->ballistics.magnitude + m->first_channel;
+	float *current_peak = s->ballistics.peak + m->first_channel;
+	if (nr_channels > m->ballistics_channels)
+		nr_channels = m->ballistics_channels;
+	for (uint32_t ch = 0; ch < nr_channels; ch++) {
+		float magnitude = snapshot->nr_frames ? sqrtf(snapshot->sum_squares[ch] / snapshot->nr_frames) : 0.0f;
+		current_magnitude[ch] = mul_to_db(magnitude);
+		current_peak[ch] = mul_to_db(snapshot->peak[ch]);
+	}
+	for (uint32_t ch = nr_channels; ch < m->ballistics_channels; ch++) {
+		current_magnitude[ch] = -M_INFINITE;
+		current_peak[ch] = -M_INFINITE;
 	}
 
-	if (c->clip_flash) {
-		if (c->clip_flash_age >= CLIP_FLASH_DURATION)
-			c->clip_flash = false;
-		else
-			c->clip_flash_age += duration;
+	/* Loudness values are already averaged over their windows. Keep the
+	 * integrated loudness while the audio is not coming. */
+	if (updated && snapshot->has_loudness) {
+		m->loudness_values = snapshot->loudness;
 	}
-	if (peak >= 0.0f && !c->clip_flash) {
-		c->clip_flash = true;
-		c->clip_flash_age = 0.0f;
+	else if (!nr_channels || !s->loudness) {
+		m->loudness_values.momentary = -M_INFINITE;
+		m->loudness_values.short_term = -M_INFINITE;
+		if (!s->loudness)
+			m->loudness_values.integrated = -M_INFINITE;
 	}
 }
 
@@ -259,87 +1028,42 @@ void tick(void *data, float duration)
 {
 	ASSERT_THREAD(OBS_TASK_GRAPHICS);
 	struct source_s *s = data;
+	uint64_t ts = os_gettime_ns();
 
-	float current_magnitude[MAX_AUDIO_CHANNELS];
-	float current_peak[MAX_AUDIO_CHANNELS];
+	for (uint32_t i = 0; i < s->nr_meters; i++)
+		tick_meter(s, s->meters[i], duration);
 
-	pthread_mutex_lock(&s->mutex);
-	memcpy(current_magnitude, s->current_magnitude, sizeof(float) * MAX_AUDIO_CHANNELS);
-	memcpy(current_peak, s->current_peak, sizeof(float) * MAX_AUDIO_CHANNELS);
-	bool updated = s->current_volume_updated;
-	if (updated) {
-		s->current_volume_updated = false;
-		s->current_volume_age = 0;
-	}
-	pthread_mutex_unlock(&s->mutex);
+	/* All the channels of all the meters at once. */
+	const struct ballistics_params_s params = {
+		.magnitude_attack_rate = s->magnitude_attack_rate,
+		.magnitude_min = s->magnitude_min,
+		.peak_decay_rate = s->peak_decay_rate_default ? gcfg.peak_decay_rate : s->peak_decay_rate,
+		.peak_hold_duration = s->peak_hold_duration,
+		.clip_flash_duration = CLIP_FLASH_DURATION,
+	};
+	ballistics_tick(&s->ballistics, &params, duration);
 
-	if (!updated) {
-		if (s->current_volume_age >= AGE_THRESHOLD) {
-			for (uint32_t ch = 0; ch < MAX_AUDIO_CHANNELS; ch++) {
-				current_magnitude[ch] = -M_INFINITE;
-				current_peak[ch] = -M_INFINITE;
-			}
-		}
-		else {
-			s->current_volume_age += duration;
-		}
+	if (s->peak_meter_type_default && s->peak_meter_type != gcfg.peak_meter_type) {
+		subscribe_volmeters(s, gcfg.peak_meter_type, s->loudness, s->update_ms);
+		s->render_dirty = true;
 	}
 
-	for (uint32_t ch = 0; ch < MAX_AUDIO_CHANNELS; ch++) {
-		tick_magnitude(s, &s->volumes[ch], current_magnitude[ch], duration);
-		tick_peak(s, &s->volumes[ch], current_peak[ch], duration);
-	}
+	for (uint32_t i = 0; i < s->nr_meters; i++)
+		tick_source(s->meters[i], duration);
 
-	if (s->peak_meter_type_default && s->peak_meter_type != gcfg.peak_meter_type) {
-		s->peak_meter_type = gcfg.peak_meter_type;
-		volmeter_set_peak_meter_type(s->volmeter, s->peak_meter_type);
-	}
+	latency_stats_end(&s->latency[SOURCE_STAGE_TICK], ts);
 }
 
 static uint32_t get_width(void *data)
 {
 	struct source_s *s = data;
-	return (DISPLAY_WIDTH_PER_CHANNEL + DISPLAY_CHANNEL_SPACING) * volmeter_get_nr_channels(s->volmeter) +
-	       LABEL_IMAGE_WIDTH + DISPLAY_PADDING * 2 - DISPLAY_CHANNEL_SPACING;
+	return s->width;
 }
 
 static uint32_t get_height(void *data)
 {
 	struct source_s *s = data;
-	return DISPLAY_HEIGHT_PER_DB * (uint32_t)-s->magnitude_min + DISPLAY_PADDING * 2;
-}
-
-static gs_vertbuffer_t *create_vbuf(uint32_t n)
-{
-	struct gs_vb_data *vrect = gs_vbdata_create();
-	vrect->num = n;
-	vrect->points = bzalloc(sizeof(struct vec3) * n);
-	vrect->num_tex = 1;
-	vrect->tvarray = bzalloc(sizeof(struct gs_tvertarray));
-	vrect->tvarray[0].width = 2;
-	vrect->tvarray[0].array = bzalloc(sizeof(struct vec2) * n);
-
-	return gs_vertexbuffer_create(vrect, GS_DYNAMIC);
-}
-
-static inline void set_v3_rect(struct vec3 *a, float x, float y, float w, float h)
-{
-	vec3_set(a + 0, x, y, 0.0f);
-	vec3_set(a + 1, x + w, y, 0.0f);
-	vec3_set(a + 2, x, y + h, 0.0f);
-	vec3_set(a + 3, x, y + h, 0.0f);
-	vec3_set(a + 4, x + w, y, 0.0f);
-	vec3_set(a + 5, x + w, y + h, 0.0f);
-}
-
-static inline void set_v2_uv(struct vec2 *a, float u, float v, float u2, float v2)
-{
-	vec2_set(a + 0, u, v);
-	vec2_set(a + 1, u2, v);
-	vec2_set(a + 2, u, v2);
-	vec2_set(a + 3, u, v2);
-	vec2_set(a + 4, u2, v);
-	vec2_set(a + 5, u2, v2);
+	return s->height;
 }
 
 static void draw_vbuf(gs_texture_t *tex, gs_vertbuffer_t *vbuf, uint32_t vbuf_size)
@@ -348,7 +1072,6 @@ static void draw_vbuf(gs_texture_t *tex, gs_vertbuffer_t *vbuf, uint32_t vbuf_si
 	gs_technique_t *tech = gs_effect_get_technique(effect, "Draw");
 	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
 
-	gs_vertexbuffer_flush(vbuf);
 	gs_load_vertexbuffer(vbuf);
 	gs_load_indexbuffer(NULL);
 
@@ -363,124 +1086,224 @@ static void draw_vbuf(gs_texture_t *tex, gs_vertbuffer_t *vbuf, uint32_t vbuf_si
 	gs_technique_end(tech);
 }
 
-static inline void render_labels(struct source_s *s, uint32_t height)
+static void draw_sprite(gs_texture_t *tex, uint32_t width, uint32_t height)
 {
-	if (!label_image.texture)
-		return;
+	gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
 
-	const uint32_t vbuf_size = N_LABELS * 6;
-	if (!s->label_vbuf) {
-		s->label_vbuf = create_vbuf(vbuf_size);
-		if (!s->label_vbuf) {
-			blog(LOG_ERROR, "Failed to create vbuf");
-			return;
-		}
-	}
+	gs_effect_set_texture(image, tex);
+	while (gs_effect_loop(effect, "Draw"))
+		gs_draw_sprite(tex, 0, width, height);
+}
 
-	struct gs_vb_data *vdata = gs_vertexbuffer_get_data(s->label_vbuf);
-	struct vec2 *tvarray = vdata->tvarray[0].array;
+static inline void render_labels(uint32_t height)
+{
+	gs_vertbuffer_t *vbuf = label_vbuf_get(height);
+	if (!vbuf)
+		return;
 
-	int label_cx = label_image.cx;
-	int label_cy = label_image.cy / N_LABELS;
-	if (label_cx != LABEL_IMAGE_WIDTH)
-		blog(LOG_WARNING, "Expected label image width %d, got %d", LABEL_IMAGE_WIDTH, label_cx);
+	draw_vbuf(label_image.texture, vbuf, N_LABELS * 6);
+}
 
-	for (int i = 0; i < N_LABELS; i++) {
-		float x = 0.0f;
-		float y = height * i / (float)(N_LABELS - 1) - label_cy * 0.5f;
+static void get_meter_thresholds(const struct source_s *s, float *warning, float *error)
+{
+	switch (s->peak_meter_type) {
+	case VOLMETER_TRUE_PEAK:
+	case VOLMETER_TRUE_PEAK_FIR4:
+	case VOLMETER_TRUE_PEAK_FIR8:
+		*warning = -13.0f;
+		*error = -2.0f;
+		break;
+	case VOLMETER_SAMPLE_PEAK:
+	default:
+		*warning = -20.0f;
+		*error = -9.0f;
+		break;
+	}
+}
 
-		set_v3_rect(vdata->points + i * 6, x, y, (float)label_cx, (float)label_cy);
-		set_v2_uv(tvarray + i * 6, 0.0f, i / (float)N_LABELS, 1.f, (i + 1) / (float)N_LABELS);
+/* Since libobs caches the effect by the path, the effect is shared by all the
+ * sources. The parameters of the source are set every time it is drawn. */
+static void set_effect_params(const struct source_s *s)
+{
+	float warning, error;
+	get_meter_thresholds(s, &warning, &error);
+
+	gs_effect_set_float(s->params.warning, warning);
+	gs_effect_set_float(s->params.error, error);
+	gs_effect_set_float(s->params.graph_columns, (float)GRAPH_WIDTH);
+
+	if (gcfg.override_colors) {
+		gs_effect_set_color(s->params.color_bg_nominal, gcfg.color_bg_nominal);
+		gs_effect_set_color(s->params.color_bg_warning, gcfg.color_bg_warning);
+		gs_effect_set_color(s->params.color_bg_error, gcfg.color_bg_error);
+		gs_effect_set_color(s->params.color_fg_nominal, gcfg.color_fg_nominal);
+		gs_effect_set_color(s->params.color_fg_warning, gcfg.color_fg_warning);
+		gs_effect_set_color(s->params.color_fg_error, gcfg.color_fg_error);
+	}
+	else {
+		gs_effect_set_default(s->params.color_bg_nominal);
+		gs_effect_set_default(s->params.color_bg_warning);
+		gs_effect_set_default(s->params.color_bg_error);
+		gs_effect_set_default(s->params.color_fg_nominal);
+		gs_effect_set_default(s->params.color_fg_warning);
+		gs_effect_set_default(s->params.color_fg_error);
 	}
+}
 
-	draw_vbuf(label_image.texture, s->label_vbuf, vbuf_size);
+static gs_vertbuffer_t *create_bars_vbuf(uint32_t nr_meters)
+{
+	const uint32_t n = N_BAR_QUADS(nr_meters) * 6;
+	struct gs_vb_data *vrect = gs_vbdata_create();
+	vrect->num = n;
+	vrect->points = bzalloc(sizeof(struct vec3) * n);
+	vrect->num_tex = 2;
+	vrect->tvarray = bzalloc(sizeof(struct gs_tvertarray) * 2);
+	for (int i = 0; i < 2; i++) {
+		vrect->tvarray[i].width = 4;
+		vrect->tvarray[i].array = bzalloc(sizeof(struct vec4) * n);
+	}
+
+	return gs_vertexbuffer_create(vrect, GS_DYNAMIC);
 }
 
-static void video_render(void *data, gs_effect_t *effect)
+/* Sets the `i`-th quad. `levels` has mag, peak and peak_hold in dB, and 1 for
+ * the background. The dB goes from 0 at the top to `db_min` at the bottom. */
+static void set_bar_quad(struct gs_vb_data *vdata, uint32_t i, float x, float y, float w, float h,
+			 const struct vec4 *levels, float db_min, float warning, float error)
 {
-	ASSERT_GRAPHICS_CONTEXT();
-	UNUSED_PARAMETER(effect);
-	struct source_s *s = data;
+	struct vec4 *tv_levels = (struct vec4 *)vdata->tvarray[0].array + i * 6;
+	struct vec4 *tv_thresholds = (struct vec4 *)vdata->tvarray[1].array + i * 6;
+
+	set_v3_rect(vdata->points + i * 6, x, y, w, h);
+	for (int j = 0; j < 6; j++) {
+		bool bottom = j == 2 || j == 3 || j == 5;
+		tv_levels[j] = *levels;
+		vec4_set(tv_thresholds + j, bottom ? db_min : 0.0f, warning, error, 0.0f);
+	}
+}
 
-	if (!s->effect)
-		return;
+static void render_bars(struct source_s *s, uint32_t meters_width, uint32_t width, uint32_t height)
+{
+	if (s->bars_vbuf && s->bars_vbuf_meters != s->nr_meters) {
+		gs_vertexbuffer_destroy(s->bars_vbuf);
+		s->bars_vbuf = NULL;
+	}
 
-	const uint32_t width = DISPLAY_WIDTH_PER_CHANNEL;
-	const uint32_t height = DISPLAY_HEIGHT_PER_DB * (uint32_t)-s->magnitude_min;
+	if (!s->bars_vbuf) {
+		s->bars_vbuf = create_bars_vbuf(s->nr_meters);
+		if (!s->bars_vbuf) {
+			blog(LOG_ERROR, "Failed to create vbuf");
+			return;
+		}
+		s->bars_vbuf_meters = s->nr_meters;
+	}
 
-	const bool srgb_prev = gs_framebuffer_srgb_enabled();
-	gs_enable_framebuffer_srgb(false);
-	gs_blend_state_push();
-	gs_reset_blend_state();
+	struct gs_vb_data *vdata = gs_vertexbuffer_get_data(s->bars_vbuf);
+	const struct ballistics_s *b = &s->ballistics;
+	const float y = (float)DISPLAY_PADDING;
+	const float step = (float)(width + DISPLAY_CHANNEL_SPACING);
+	struct vec4 levels;
+	float warning, error;
+	uint32_t n = 0;
+
+	vec4_set(&levels, -M_INFINITE, -M_INFINITE, -M_INFINITE, 1.0f);
+	set_bar_quad(vdata, n++, 0.0f, 0.0f, (float)s->width, (float)s->height, &levels, 0.0f, 0.0f, 0.0f);
+
+	if (s->render_mode == RENDER_MODE_METER) {
+		get_meter_thresholds(s, &warning, &error);
+		float x0 = (float)DISPLAY_PADDING;
+		for (uint32_t i = 0; i < s->nr_meters; i++) {
+			const struct meter_s *m = s->meters[i];
+			for (uint32_t ch = 0; ch < m->ballistics_channels; ch++) {
+				const uint32_t c = m->first_channel + ch;
+				float x = x0 + step * ch;
+				vec4_set(&levels, b->display_magnitude[c], b->clip_flash[c] ? 0.0f : b->display_peak[c],
+					 b->peak_hold[c], 0.0f);
+				set_bar_quad(vdata, n++, x, y, (float)width, (float)height, &levels, s->magnitude_min,
+					     warning, error);
+			}
+			x0 += (float)(get_meter_width(s, m) + DISPLAY_METER_SPACING);
+		}
+	}
 
-	{
-		effect = obs_get_base_effect(OBS_EFFECT_SOLID);
-		gs_effect_set_color(gs_effect_get_param_by_name(effect, "color"), 0x80000000);
-		const float w = (float)get_width(s);
-		const float h = (float)get_height(s);
-		while (gs_effect_loop(effect, "Solid")) {
-			gs_render_start(false);
-			gs_vertex2f(0.0f, h);
-			gs_vertex2f(0.0f, 0.0f);
-			gs_vertex2f(w, h);
-			gs_vertex2f(w, 0.0f);
-			gs_render_stop(GS_TRISTRIP);
+	if (s->loudness) {
+		warning = LOUDNESS_TARGET - LOUDNESS_TOLERANCE;
+		error = LOUDNESS_TARGET + LOUDNESS_TOLERANCE;
+		float x0 = (float)(meters_width + DISPLAY_PADDING + LABEL_IMAGE_WIDTH + DISPLAY_CHANNEL_SPACING);
+		for (uint32_t i = 0; i < s->nr_meters; i++) {
+			const struct meter_s *m = s->meters[i];
+			const float values[N_LOUDNESS_BARS] = {
+				m->loudness_values.momentary,
+				m->loudness_values.short_term,
+				m->loudness_values.integrated,
+			};
+			for (int j = 0; j < N_LOUDNESS_BARS; j++) {
+				vec4_set(&levels, -M_INFINITE, values[j], -M_INFINITE, 0.0f);
+				set_bar_quad(vdata, n++, x0 + step * j, y, (float)width, (float)height, &levels,
+					     s->magnitude_min, warning, error);
+			}
+			x0 += (float)(LOUDNESS_BARS_WIDTH + DISPLAY_METER_SPACING);
 		}
 	}
 
-	const uint32_t channels = volmeter_get_nr_channels(s->volmeter);
-	for (uint32_t ch = 0; ch < channels; ch++) {
-		struct channel_volume_s *v = s->volumes + ch;
+	gs_vertexbuffer_flush(s->bars_vbuf);
+	gs_load_vertexbuffer(s->bars_vbuf);
+	gs_load_indexbuffer(NULL);
 
-		gs_effect_set_float(gs_effect_get_param_by_name(s->effect, "mag_min"), s->magnitude_min);
+	while (gs_effect_loop(s->effect, "DrawBars"))
+		gs_draw(GS_TRIS, 0, n * 6);
+}
 
-		switch (s->peak_meter_type) {
-		case TRUE_PEAK_METER:
-			gs_effect_set_float(gs_effect_get_param_by_name(s->effect, "warning"), -13.0f);
-			gs_effect_set_float(gs_effect_get_param_by_name(s->effect, "error"), -2.0f);
-			break;
-		case SAMPLE_PEAK_METER:
-		default:
-			gs_effect_set_float(gs_effect_get_param_by_name(s->effect, "warning"), -20.0f);
-			gs_effect_set_float(gs_effect_get_param_by_name(s->effect, "error"), -9.0f);
-			break;
-		}
+static void render_graph(struct source_s *s, struct meter_s *m, float x, uint32_t height)
+{
+	if (!m->history)
+		return;
 
-		if (gcfg.override_colors) {
-			gs_effect_set_color(gs_effect_get_param_by_name(s->effect, "color_bg_nominal"),
-					    gcfg.color_bg_nominal);
-			gs_effect_set_color(gs_effect_get_param_by_name(s->effect, "color_bg_warning"),
-					    gcfg.color_bg_warning);
-			gs_effect_set_color(gs_effect_get_param_by_name(s->effect, "color_bg_error"),
-					    gcfg.color_bg_error);
-			gs_effect_set_color(gs_effect_get_param_by_name(s->effect, "color_fg_nominal"),
-					    gcfg.color_fg_nominal);
-			gs_effect_set_color(gs_effect_get_param_by_name(s->effect, "color_fg_warning"),
-					    gcfg.color_fg_warning);
-			gs_effect_set_color(gs_effect_get_param_by_name(s->effect, "color_fg_error"),
-					    gcfg.color_fg_error);
+	if (!m->graph_texture) {
+		m->graph_texture = gs_texture_create(GRAPH_WIDTH, 1, GS_RGBA32F, 1, NULL, GS_DYNAMIC);
+		if (!m->graph_texture) {
+			blog(LOG_ERROR, "Failed to create graph texture");
+			return;
 		}
+		m->graph_dirty = true;
+	}
 
-		gs_effect_set_float(gs_effect_get_param_by_name(s->effect, "mag"), v->display_magnitude);
-		gs_effect_set_float(gs_effect_get_param_by_name(s->effect, "peak"),
-				    v->clip_flash ? 0.0f : v->display_peak);
-		gs_effect_set_float(gs_effect_get_param_by_name(s->effect, "peak_hold"), v->peak_hold);
+	/* libobs cannot update a part of a texture. Since the columns are
+	 * converted when appended and the texture is a ring, the whole
+	 * texture is just copied once a column is appended. */
+	if (m->graph_dirty) {
+		gs_texture_set_image(m->graph_texture, (const uint8_t *)m->graph_data, sizeof(m->graph_data), false);
+		m->graph_dirty = false;
+	}
 
-		gs_matrix_push();
+	gs_effect_set_texture(s->params.graph, m->graph_texture);
+	gs_effect_set_float(s->params.graph_offset, (float)(m->graph_count % GRAPH_WIDTH) / GRAPH_WIDTH);
 
-		struct matrix4 tr = {
-			{.ptr = {1.0f, 0.0f, 0.0f, 0.0f}},
-			{.ptr = {0.0f, 1.0f, 0.0f, 0.0f}},
-			{.ptr = {0.0f, 0.0f, 1.0f, 0.0f}},
-			{.ptr = {(float)((width + DISPLAY_CHANNEL_SPACING) * ch + DISPLAY_PADDING),
-				 (float)DISPLAY_PADDING, 0.0f, 1.0f}},
-		};
-		gs_matrix_mul(&tr);
+	gs_matrix_push();
+	gs_matrix_translate3f(x, (float)DISPLAY_PADDING, 0.0f);
 
-		while (gs_effect_loop(s->effect, "DrawVolMeter"))
-			gs_draw_sprite(0, 0, width, height);
+	while (gs_effect_loop(s->effect, "DrawGraph"))
+		gs_draw_sprite(0, 0, GRAPH_WIDTH, height);
 
-		gs_matrix_pop();
+	gs_matrix_pop();
+}
+
+static void render_meter(struct source_s *s)
+{
+	const uint32_t width = DISPLAY_WIDTH_PER_CHANNEL;
+	const uint32_t height = DISPLAY_HEIGHT_PER_DB * (uint32_t)-s->magnitude_min;
+
+	const uint32_t meters_width = get_meters_width(s);
+
+	set_effect_params(s);
+	render_bars(s, meters_width, width, height);
+
+	if (s->render_mode == RENDER_MODE_GRAPH) {
+		for (uint32_t i = 0; i < s->nr_meters; i++) {
+			float x = (float)(DISPLAY_PADDING + (GRAPH_WIDTH + DISPLAY_METER_SPACING) * i);
+			render_graph(s, s->meters[i], x, height);
+		}
 	}
 
 	{
@@ -490,61 +1313,180 @@ static void video_render(void *data, gs_effect_t *effect)
 			{.ptr = {1.0f, 0.0f, 0.0f, 0.0f}},
 			{.ptr = {0.0f, 1.0f, 0.0f, 0.0f}},
 			{.ptr = {0.0f, 0.0f, 1.0f, 0.0f}},
-			{.ptr = {(float)((width + DISPLAY_CHANNEL_SPACING) * channels + DISPLAY_PADDING -
-					 DISPLAY_CHANNEL_SPACING),
-				 (float)DISPLAY_PADDING, 0.0f, 1.0f}},
+			{.ptr = {(float)(meters_width + DISPLAY_PADDING), (float)DISPLAY_PADDING, 0.0f, 1.0f}},
 		};
 		gs_matrix_mul(&tr);
 
-		render_labels(s, height);
+		render_labels(height);
 
 		gs_matrix_pop();
 	}
+}
 
-	gs_blend_state_pop();
-	gs_enable_framebuffer_srgb(srgb_prev);
+static inline int32_t quantize_db(const struct source_s *s, float db)
+{
+	if (isnan(db))
+		db = -M_INFINITE;
+	return (int32_t)floorf(-clamp_flt(db, s->magnitude_min - 1.0f, 1.0f) * DISPLAY_HEIGHT_PER_DB + 0.5f);
 }
 
-static void audio_cb(void *param, size_t mix_idx, struct audio_data *data)
+static void get_render_state(const struct source_s *s, struct render_state_s *state)
 {
-	ASSERT_THREAD(OBS_TASK_AUDIO);
-	UNUSED_PARAMETER(mix_idx);
-	struct source_s *s = param;
+	const struct ballistics_s *b = &s->ballistics;
+
+	memset(state, 0, sizeof(*state));
+	state->width = s->width;
+	state->height = s->height;
+	state->nr_meters = s->nr_meters;
+	state->has_labels = label_image.texture != NULL;
+
+	for (uint32_t i = 0; i < s->nr_meters; i++) {
+		const struct meter_s *m = s->meters[i];
+		int32_t(*bars)[4] = state->bars[i];
+
+		if (s->render_mode == RENDER_MODE_GRAPH) {
+			state->graph_count[i] = m->graph_count;
+		}
+		else {
+			for (uint32_t ch = 0; ch < m->ballistics_channels; ch++) {
+				const uint32_t c = m->first_channel + ch;
+				bars[ch][0] = quantize_db(s, b->display_magnitude[c]);
+				bars[ch][1] = quantize_db(s, b->display_peak[c]);
+				bars[ch][2] = quantize_db(s, b->peak_hold[c]);
+				bars[ch][3] = b->clip_flash[c];
+			}
+		}
+
+		if (s->loudness) {
+			bars[MAX_AUDIO_CHANNELS + 0][1] = quantize_db(s, m->loudness_values.momentary);
+			bars[MAX_AUDIO_CHANNELS + 1][1] = quantize_db(s, m->loudness_values.short_term);
+			bars[MAX_AUDIO_CHANNELS + 2][1] = quantize_db(s, m->loudness_values.integrated);
+		}
+	}
+}
+
+static void video_render(void *data, gs_effect_t *effect)
+{
+	ASSERT_GRAPHICS_CONTEXT();
+	UNUSED_PARAMETER(effect);
+	struct source_s *s = data;
 
-	audio_t *audio = obs_get_audio();
-	if (!audio)
+	if (!s->effect)
 		return;
 
-	/* Need to align the audio data */
-	struct audio_data ad = *data;
+	uint64_t ts = os_gettime_ns();
+	const bool srgb_prev = gs_framebuffer_srgb_enabled();
+	gs_enable_framebuffer_srgb(false);
+	gs_blend_state_push();
+	gs_reset_blend_state();
+
+	bool changed = false;
+	if (s->render_dirty || s->render_gcfg_generation != gcfg.generation) {
+		s->render_dirty = false;
+		s->render_gcfg_generation = gcfg.generation;
+		changed = true;
+	}
 
-	uint32_t planes = (uint32_t)audio_output_get_planes(audio);
-	da_resize(s->buffer, sizeof(float) * AUDIO_OUTPUT_FRAMES * planes);
+	struct render_state_s state;
+	get_render_state(s, &state);
+	if (!s->render_cached || memcmp(&state, &s->render_state, sizeof(state)) != 0)
+		changed = true;
+
+	if (!s->texrender)
+		s->texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+
+	if (s->texrender_failed && (s->texrender_failed_width != s->width || s->texrender_failed_height != s->height))
+		s->texrender_failed = false;
+
+	/* Redraw the cached image only if any pixel will change. */
+	if (s->texrender && !s->texrender_failed && changed) {
+		uint64_t ts_redraw = os_gettime_ns();
+		s->render_cached = false;
+		gs_texrender_reset(s->texrender);
+		if (gs_texrender_begin(s->texrender, s->width, s->height)) {
+			struct vec4 clear_color;
+			vec4_zero(&clear_color);
+			gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+			gs_ortho(0.0f, (float)s->width, 0.0f, (float)s->height, -100.0f, 100.0f);
+
+			render_meter(s);
+
+			gs_texrender_end(s->texrender);
+			s->render_state = state;
+			s->render_cached = true;
+		}
+		else {
+			blog(LOG_WARNING, "Failed to render %" PRIu32 "x%" PRIu32 " meter to texture, drawing directly",
+			     s->width, s->height);
+			s->texrender_failed = true;
+			s->texrender_failed_width = s->width;
+			s->texrender_failed_height = s->height;
+		}
+		latency_stats_end(&s->latency[SOURCE_STAGE_REDRAW], ts_redraw);
+	}
 
-	for (uint32_t i = 0; i < planes; i++) {
-		ad.data[i] = s->buffer.array + sizeof(float) * AUDIO_OUTPUT_FRAMES * i;
-		memcpy(ad.data[i], data->data[i], sizeof(float) * AUDIO_OUTPUT_FRAMES);
+	if (!s->texrender || s->texrender_failed) {
+		render_meter(s);
 	}
-	for (uint32_t i = planes; i < MAX_AV_PLANES; i++)
-		ad.data[i] = NULL;
+	else {
+		gs_texture_t *tex = gs_texrender_get_texture(s->texrender);
+		if (s->render_cached && tex) {
+			/* The alpha is already multiplied in the cached image. */
+			gs_blend_function(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+			draw_sprite(tex, s->width, s->height);
+		}
+	}
+
+	gs_blend_state_pop();
+	gs_enable_framebuffer_srgb(srgb_prev);
 
-	volmeter_push_audio_data(s->volmeter, &ad);
+	latency_stats_end(&s->latency[SOURCE_STAGE_RENDER], ts);
 }
 
-static void volume_cb(void *param, const float magnitude[MAX_AUDIO_CHANNELS], const float peak[MAX_AUDIO_CHANNELS],
-		      const float input_peak[MAX_AUDIO_CHANNELS])
+/* Called by the audio thread for a track, or by the thread outputting the audio
+ * of the source, such as the decoder of an async source. The calls for one
+ * volmeter are not concurrent. Also referred to as the audio thread above. */
+static void volume_cb(void *param, const struct volmeter_levels_s *levels)
 {
-	ASSERT_THREAD(OBS_TASK_AUDIO);
-	UNUSED_PARAMETER(input_peak);
-	struct source_s *s = param;
+	struct meter_s *m = param;
+	uint64_t ts = os_gettime_ns();
+
+	/* Take the middle one. Since the middle one is not dirty while the
+	 * audio thread holds it, the graphics thread won't take it. */
+	long middle = os_atomic_exchange_long(&m->snapshot_middle, m->snapshot_back);
+	struct volume_snapshot_s *snapshot = &m->snapshots[middle & ~SNAPSHOT_DIRTY];
+
+	/* If the graphics thread has taken the previous one, the middle one
+	 * is an old front one. Start accumulating from scratch. */
+	if (!(middle & SNAPSHOT_DIRTY) || snapshot->nr_channels != levels->nr_channels) {
+		snapshot->nr_channels = levels->nr_channels;
+		snapshot->nr_frames = 0;
+		snapshot->packet_peak_min = M_INFINITE;
+		snapshot->has_loudness = false;
+		for (uint32_t ch = 0; ch < levels->nr_channels; ch++) {
+			snapshot->sum_squares[ch] = 0.0f;
+			snapshot->peak[ch] = 0.0f;
+		}
+	}
 
-	pthread_mutex_lock(&s->mutex);
+	float packet_peak = 0.0f;
+	snapshot->nr_frames += levels->nr_frames;
+	for (uint32_t ch = 0; ch < levels->nr_channels; ch++) {
+		float magnitude = levels->magnitude[ch];
+		snapshot->sum_squares[ch] += magnitude * magnitude * levels->nr_frames;
+		snapshot->peak[ch] = fmaxf(snapshot->peak[ch], levels->peak[ch]);
+		packet_peak = fmaxf(packet_peak, levels->peak[ch]);
+	}
+	snapshot->packet_peak_min = fminf(snapshot->packet_peak_min, packet_peak);
+
+	if (levels->has_loudness) {
+		snapshot->has_loudness = true;
+		snapshot->loudness = levels->loudness;
+	}
 
-	memcpy(s->current_magnitude, magnitude, sizeof(float) * MAX_AUDIO_CHANNELS);
-	memcpy(s->current_peak, peak, sizeof(float) * MAX_AUDIO_CHANNELS);
-	s->current_volume_updated = true;
+	m->snapshot_back = os_atomic_exchange_long(&m->snapshot_middle, (middle & ~SNAPSHOT_DIRTY) | SNAPSHOT_DIRTY);
 
-	pthread_mutex_unlock(&s->mutex);
+	latency_stats_end(&m->parent->latency[SOURCE_STAGE_VOLUME_CB], ts);
 }
 
 const struct obs_source_info volmeter_source_info = {
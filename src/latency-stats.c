@@ -0,0 +1,124 @@
+/*
+Graphical Volume Meter Plugin for OBS Studio
+Copyright (C) 2026 Norihiro Kamae <norihiro@nagater.net>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <inttypes.h>
+#include <limits.h>
+#include <obs.h>
+#include <util/threading.h>
+#include "plugin-macros.generated.h"
+#include "latency-stats.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/* libobs has the atomic operations only for `long`, which is 32-bit on
+ * Windows and would saturate at about 2 seconds. */
+static inline long long atomic_load_ll(const volatile long long *ptr)
+{
+#ifdef _MSC_VER
+	return _InterlockedCompareExchange64((volatile long long *)ptr, 0, 0);
+#else
+	return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static inline bool atomic_compare_exchange_ll(volatile long long *ptr, long long *old_val, long long new_val)
+{
+#ifdef _MSC_VER
+	long long prev = _InterlockedCompareExchange64(ptr, new_val, *old_val);
+	bool success = prev == *old_val;
+	*old_val = prev;
+	return success;
+#else
+	return __atomic_compare_exchange_n(ptr, old_val, new_val, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static inline int bucket_of(uint64_t ns)
+{
+	int b = 0;
+	while (ns > 1 && b < LATENCY_STATS_BUCKETS - 1) {
+		ns >>= 1;
+		b++;
+	}
+	return b;
+}
+
+void latency_stats_add(struct latency_stats_s *stats, uint64_t ns)
+{
+	os_atomic_inc_long(&stats->counts[bucket_of(ns)]);
+
+	long long value = ns > LLONG_MAX ? LLONG_MAX : (long long)ns;
+	long long max = atomic_load_ll(&stats->max_ns);
+	while (value > max && !atomic_compare_exchange_ll(&stats->max_ns, &max, value))
+		;
+}
+
+static uint64_t percentile(const long counts[LATENCY_STATS_BUCKETS], uint64_t total, uint64_t permille)
+{
+	uint64_t target = (total * permille + 999) / 1000;
+	uint64_t sum = 0;
+	for (int b = 0; b < LATENCY_STATS_BUCKETS; b++) {
+		sum += counts[b];
+		if (sum >= target)
+			return (uint64_t)2 << b;
+	}
+	return (uint64_t)2 << (LATENCY_STATS_BUCKETS - 1);
+}
+
+void latency_stats_get_summary(const struct latency_stats_s *stats, struct latency_summary_s *summary)
+{
+	long counts[LATENCY_STATS_BUCKETS];
+	uint64_t total = 0;
+	for (int b = 0; b < LATENCY_STATS_BUCKETS; b++) {
+		counts[b] = os_atomic_load_long(&stats->counts[b]);
+		total += counts[b];
+	}
+
+	summary->count = total;
+	summary->p50_ns = total ? percentile(counts, total, 500) : 0;
+	summary->p99_ns = total ? percentile(counts, total, 990) : 0;
+	summary->max_ns = (uint64_t)atomic_load_ll(&stats->max_ns);
+}
+
+void latency_stats_to_data(const struct latency_stats_s *stats, obs_data_t *data, const char *name)
+{
+	struct latency_summary_s summary;
+	latency_stats_get_summary(stats, &summary);
+
+	obs_data_t *obj = obs_data_create();
+	obs_data_set_int(obj, "count", (long long)summary.count);
+	obs_data_set_int(obj, "p50_ns", (long long)summary.p50_ns);
+	obs_data_set_int(obj, "p99_ns", (long long)summary.p99_ns);
+	obs_data_set_int(obj, "max_ns", (long long)summary.max_ns);
+	obs_data_set_obj(data, name, obj);
+	obs_data_release(obj);
+}
+
+void latency_stats_log(const struct latency_stats_s *stats, const char *context, const char *name)
+{
+	struct latency_summary_s summary;
+	latency_stats_get_summary(stats, &summary);
+	if (!summary.count)
+		return;
+
+	blog(LOG_INFO, "%s: %s: count=%" PRIu64 " p50<%" PRIu64 "us p99<%" PRIu64 "us max=%" PRIu64 "us", context,
+	     name, summary.count, summary.p50_ns / 1000, summary.p99_ns / 1000, summary.max_ns / 1000);
+}
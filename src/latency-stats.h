@@ -0,0 +1,46 @@
+#pragma once
+
+#include <obs.h>
+#include <util/platform.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Histogram of the time taken by a stage, in buckets of powers of 2 in ns.
+ * A stage may be recorded by several threads at once, such as the volume
+ * callbacks of the meters of a bank, each from the thread of its source.
+ * The counters are updated and read by atomic operations without locking. */
+#define LATENCY_STATS_BUCKETS 32
+
+struct latency_stats_s
+{
+	volatile long counts[LATENCY_STATS_BUCKETS];
+	volatile long long max_ns;
+};
+
+struct latency_summary_s
+{
+	uint64_t count;
+	uint64_t p50_ns; // upper bound of the bucket
+	uint64_t p99_ns; // upper bound of the bucket
+	uint64_t max_ns;
+};
+
+void latency_stats_add(struct latency_stats_s *stats, uint64_t ns);
+
+static inline void latency_stats_end(struct latency_stats_s *stats, uint64_t begin_ns)
+{
+	latency_stats_add(stats, os_gettime_ns() - begin_ns);
+}
+
+void latency_stats_get_summary(const struct latency_stats_s *stats, struct latency_summary_s *summary);
+
+/* Sets the summary as an object named `name` into `data`. */
+void latency_stats_to_data(const struct latency_stats_s *stats, obs_data_t *data, const char *name);
+
+void latency_stats_log(const struct latency_stats_s *stats, const char *context, const char *name);
+
+#ifdef __cplusplus
+}
+#endif
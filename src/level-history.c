@@ -0,0 +1,161 @@
+/*
+Graphical Volume Meter Plugin for OBS Studio
+Copyright (C) 2026 Norihiro Kamae <norihiro@nagater.net>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <math.h>
+#include <obs.h>
+#include "level-history.h"
+
+/* These are pointless warnings generated not by our code, but by a standard
+ * library macro, INFINITY */
+#ifdef _MSC_VER
+#pragma warning(disable : 4056)
+#pragma warning(disable : 4756)
+#endif
+
+#define COLUMNS_PER_SECOND 10
+
+/* Number of the columns of the level below to make one column. */
+static const uint32_t level_ratio[LEVEL_HISTORY_NR_LEVELS] = {
+	[LEVEL_HISTORY_1S] = 10,
+	[LEVEL_HISTORY_10S] = 10,
+	[LEVEL_HISTORY_1MIN] = 6,
+};
+
+struct level_s
+{
+	struct level_history_column_s columns[LEVEL_HISTORY_COLUMNS];
+	uint64_t count;
+
+	// column being accumulated
+	struct level_history_column_s pending;
+	uint32_t nr_pending;
+};
+
+struct level_history_s
+{
+	uint64_t frames_per_column;
+	uint64_t pending_frames;
+
+	struct level_s levels[LEVEL_HISTORY_NR_LEVELS];
+};
+
+static inline void column_reset(struct level_history_column_s *c)
+{
+	c->peak_min = INFINITY;
+	c->peak_max = 0.0f;
+	c->sum_squares = 0.0;
+	c->nr_samples = 0;
+	c->loudness = -INFINITY;
+}
+
+static inline void column_merge(struct level_history_column_s *c, const struct level_history_column_s *x)
+{
+	c->peak_min = fminf(c->peak_min, x->peak_min);
+	c->peak_max = fmaxf(c->peak_max, x->peak_max);
+	c->sum_squares += x->sum_squares;
+	c->nr_samples += x->nr_samples;
+	c->loudness = fmaxf(c->loudness, x->loudness);
+}
+
+static void level_push(struct level_history_s *h, int level, const struct level_history_column_s *column)
+{
+	struct level_s *l = &h->levels[level];
+	l->columns[l->count % LEVEL_HISTORY_COLUMNS] = *column;
+	l->count++;
+
+	if (level + 1 >= LEVEL_HISTORY_NR_LEVELS)
+		return;
+
+	struct level_s *upper = &h->levels[level + 1];
+	column_merge(&upper->pending, column);
+	if (++upper->nr_pending >= level_ratio[level + 1]) {
+		level_push(h, level + 1, &upper->pending);
+		column_reset(&upper->pending);
+		upper->nr_pending = 0;
+	}
+}
+
+level_history_t *level_history_create(uint32_t sample_rate)
+{
+	if (sample_rate < COLUMNS_PER_SECOND)
+		return NULL;
+
+	struct level_history_s *h = bzalloc(sizeof(struct level_history_s));
+	h->frames_per_column = sample_rate / COLUMNS_PER_SECOND;
+	for (int i = 0; i < LEVEL_HISTORY_NR_LEVELS; i++)
+		column_reset(&h->levels[i].pending);
+	return h;
+}
+
+void level_history_destroy(level_history_t *h)
+{
+	bfree(h);
+}
+
+/* Merges the share of `nr_frames` out of `total_frames` of the column.
+ * The peaks cannot be split and are merged as they are. */
+static inline void column_merge_part(struct level_history_column_s *c, const struct level_history_column_s *x,
+				     uint64_t nr_frames, uint64_t total_frames)
+{
+	struct level_history_column_s part = *x;
+	if (nr_frames < total_frames) {
+		double ratio = (double)nr_frames / total_frames;
+		part.sum_squares *= ratio;
+		part.nr_samples = (uint64_t)(part.nr_samples * ratio);
+	}
+	column_merge(c, &part);
+}
+
+void level_history_add(level_history_t *h, const struct level_history_column_s *column, uint64_t nr_frames)
+{
+	struct level_s *l = &h->levels[0];
+	uint64_t remaining = nr_frames;
+
+	/* If the levels of more than one period come at once, the columns of
+	 * the periods have the same levels so that the time axis is kept. */
+	while (h->pending_frames + remaining >= h->frames_per_column) {
+		uint64_t n = h->frames_per_column - h->pending_frames;
+		column_merge_part(&l->pending, column, n, nr_frames);
+		level_push(h, 0, &l->pending);
+		column_reset(&l->pending);
+		h->pending_frames = 0;
+		remaining -= n;
+	}
+
+	if (remaining) {
+		column_merge_part(&l->pending, column, remaining, nr_frames);
+		h->pending_frames += remaining;
+	}
+}
+
+uint64_t level_history_get_count(const level_history_t *h, enum level_history_level level)
+{
+	return h->levels[level].count;
+}
+
+bool level_history_get_column(const level_history_t *h, enum level_history_level level, uint64_t index,
+			      struct level_history_column_s *column)
+{
+	const struct level_s *l = &h->levels[level];
+	if (index >= l->count || index + LEVEL_HISTORY_COLUMNS < l->count)
+		return false;
+
+	*column = l->columns[index % LEVEL_HISTORY_COLUMNS];
+	return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct level_history_s level_history_t;
+
+/* Resolutions of the history. Each level is made from the columns of the
+ * level below so that a long window is drawn from a few columns. */
+enum level_history_level {
+	LEVEL_HISTORY_100MS,
+	LEVEL_HISTORY_1S,
+	LEVEL_HISTORY_10S,
+	LEVEL_HISTORY_1MIN,
+	LEVEL_HISTORY_NR_LEVELS,
+};
+
+/* Number of the columns kept for each level. */
+#define LEVEL_HISTORY_COLUMNS 512
+
+/* Levels aggregated over a period, in linear scale except the loudness. */
+struct level_history_column_s
+{
+	float peak_min; // minimum of the peaks of the packets
+	float peak_max;
+	double sum_squares;
+	uint64_t nr_samples;
+	float loudness; // maximum of the momentary loudness [LUFS]
+};
+
+level_history_t *level_history_create(uint32_t sample_rate);
+void level_history_destroy(level_history_t *history);
+
+/* Accumulates the levels of `nr_frames` frames. A column is appended to
+ * each level when its period is filled. */
+void level_history_add(level_history_t *history, const struct level_history_column_s *column, uint64_t nr_frames);
+
+/* Returns the number of the columns ever appended to `level`. */
+uint64_t level_history_get_count(const level_history_t *history, enum level_history_level level);
+
+/* Gets the column at `index` counted from the first one ever appended.
+ * Returns false if the column has been overwritten or not appended yet. */
+bool level_history_get_column(const level_history_t *history, enum level_history_level level, uint64_t index,
+			      struct level_history_column_s *column);
+
+#ifdef __cplusplus
+}
+#endif
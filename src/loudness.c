@@ -0,0 +1,310 @@
+/*
+Graphical Volume Meter Plugin for OBS Studio
+Copyright (C) 2026 Norihiro Kamae <norihiro@nagater.net>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <math.h>
+#include <string.h>
+#include <obs.h>
+#include "loudness.h"
+
+/* These are pointless warnings generated not by our code, but by a standard
+ * library macro, INFINITY */
+#ifdef _MSC_VER
+#pragma warning(disable : 4056)
+#pragma warning(disable : 4756)
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* The gating blocks of 400 ms and the short-term window of 3 s are made of
+ * the sub-blocks of 100 ms, which is the step of the gating blocks. */
+#define SUBBLOCKS_PER_SECOND 10
+#define MOMENTARY_SUBBLOCKS 4
+#define SHORT_TERM_SUBBLOCKS 30
+
+/* The integrated loudness is gated by the histogram of the block loudness
+ * instead of storing all the blocks so that the memory doesn't grow.
+ * Each bin also has the sum of the energy so that only the gate is
+ * quantized. */
+#define ABSOLUTE_GATE (-70.0)
+#define RELATIVE_GATE (-10.0)
+#define HISTOGRAM_MAX 10.0
+#define HISTOGRAM_STEP 0.1
+#define HISTOGRAM_BINS 800 // (HISTOGRAM_MAX - ABSOLUTE_GATE) / HISTOGRAM_STEP
+
+struct biquad_s
+{
+	double b0, b1, b2, a1, a2;
+};
+
+struct loudness_s
+{
+	uint32_t sample_rate;
+	uint32_t nr_channels;
+
+	// K-weighting filter, pre-filter and RLB filter
+	struct biquad_s pre;
+	struct biquad_s rlb;
+	double state[MAX_AUDIO_CHANNELS][2][2];
+
+	// sub-block being accumulated
+	uint32_t subblock_frames;
+	uint32_t subblock_pos;
+	double subblock_sum[MAX_AUDIO_CHANNELS];
+
+	// weighted mean squares of the last sub-blocks
+	double subblocks[SHORT_TERM_SUBBLOCKS];
+	uint32_t subblock_idx;
+	uint32_t nr_subblocks;
+
+	uint32_t histogram[HISTOGRAM_BINS];
+	double histogram_energy[HISTOGRAM_BINS];
+
+	struct loudness_values_s values;
+};
+
+/* Coefficients of the K-weighting filter at any sample rate, derived from
+ * the analog prototype of the filter given at 48 kHz by BS.1770. */
+static void init_filters(struct loudness_s *l)
+{
+	const double fs = (double)l->sample_rate;
+
+	{
+		const double f0 = 1681.974450955533;
+		const double gain = 3.999843853973347;
+		const double q = 0.7071752369554196;
+
+		const double k = tan(M_PI * f0 / fs);
+		const double vh = pow(10.0, gain / 20.0);
+		const double vb = pow(vh, 0.4996667741545416);
+		const double a0 = 1.0 + k / q + k * k;
+
+		l->pre.b0 = (vh + vb * k / q + k * k) / a0;
+		l->pre.b1 = 2.0 * (k * k - vh) / a0;
+		l->pre.b2 = (vh - vb * k / q + k * k) / a0;
+		l->pre.a1 = 2.0 * (k * k - 1.0) / a0;
+		l->pre.a2 = (1.0 - k / q + k * k) / a0;
+	}
+
+	{
+		const double f0 = 38.13547087602444;
+		const double q = 0.5003270373238773;
+
+		const double k = tan(M_PI * f0 / fs);
+		const double a0 = 1.0 + k / q + k * k;
+
+		l->rlb.b0 = 1.0;
+		l->rlb.b1 = -2.0;
+		l->rlb.b2 = 1.0;
+		l->rlb.a1 = 2.0 * (k * k - 1.0) / a0;
+		l->rlb.a2 = (1.0 - k / q + k * k) / a0;
+	}
+}
+
+/* Weights of the channels in the order of libobs, with the LFE excluded. */
+static double channel_weight(uint32_t nr_channels, uint32_t ch)
+{
+	static const double w_2_1[] = {1.0, 1.0, 0.0};
+	static const double w_4_0[] = {1.0, 1.0, 1.0, 1.41};
+	static const double w_4_1[] = {1.0, 1.0, 1.0, 0.0, 1.41};
+	static const double w_5_1[] = {1.0, 1.0, 1.0, 0.0, 1.41, 1.41};
+	static const double w_7_1[] = {1.0, 1.0, 1.0, 0.0, 1.41, 1.41, 1.41, 1.41};
+
+	switch (nr_channels) {
+	case 3:
+		return w_2_1[ch];
+	case 4:
+		return w_4_0[ch];
+	case 5:
+		return w_4_1[ch];
+	case 6:
+		return w_5_1[ch];
+	case 8:
+		return w_7_1[ch];
+	default:
+		return 1.0;
+	}
+}
+
+static inline double energy_to_lufs(double energy)
+{
+	return energy > 0.0 ? -0.691 + 10.0 * log10(energy) : -INFINITY;
+}
+
+static inline double histogram_lufs(int bin)
+{
+	return ABSOLUTE_GATE + HISTOGRAM_STEP * bin;
+}
+
+static double mean_subblocks(const struct loudness_s *l, uint32_t n)
+{
+	double sum = 0.0;
+	for (uint32_t i = 0; i < n; i++) {
+		uint32_t idx = (l->subblock_idx + SHORT_TERM_SUBBLOCKS - 1 - i) % SHORT_TERM_SUBBLOCKS;
+		sum += l->subblocks[idx];
+	}
+	return sum / n;
+}
+
+static void update_integrated(struct loudness_s *l)
+{
+	double sum = 0.0;
+	uint64_t count = 0;
+	for (int i = 0; i < HISTOGRAM_BINS; i++) {
+		sum += l->histogram_energy[i];
+		count += l->histogram[i];
+	}
+	if (!count)
+		return;
+
+	const double gate = energy_to_lufs(sum / count) + RELATIVE_GATE;
+
+	sum = 0.0;
+	count = 0;
+	for (int i = 0; i < HISTOGRAM_BINS; i++) {
+		/* The bin containing the gate is included. */
+		if (histogram_lufs(i + 1) > gate) {
+			sum += l->histogram_energy[i];
+			count += l->histogram[i];
+		}
+	}
+	if (count)
+		l->values.integrated = (float)energy_to_lufs(sum / count);
+}
+
+static void end_subblock(struct loudness_s *l)
+{
+	double z = 0.0;
+	for (uint32_t ch = 0; ch < l->nr_channels; ch++) {
+		z += channel_weight(l->nr_channels, ch) * l->subblock_sum[ch] / l->subblock_frames;
+		l->subblock_sum[ch] = 0.0;
+	}
+	l->subblock_pos = 0;
+
+	l->subblocks[l->subblock_idx] = z;
+	l->subblock_idx = (l->subblock_idx + 1) % SHORT_TERM_SUBBLOCKS;
+	if (l->nr_subblocks < SHORT_TERM_SUBBLOCKS)
+		l->nr_subblocks++;
+
+	if (l->nr_subblocks >= SHORT_TERM_SUBBLOCKS)
+		l->values.short_term = (float)energy_to_lufs(mean_subblocks(l, SHORT_TERM_SUBBLOCKS));
+
+	if (l->nr_subblocks >= MOMENTARY_SUBBLOCKS) {
+		double block_energy = mean_subblocks(l, MOMENTARY_SUBBLOCKS);
+		double block_lufs = energy_to_lufs(block_energy);
+		l->values.momentary = (float)block_lufs;
+
+		if (block_lufs > ABSOLUTE_GATE) {
+			int bin = (int)((block_lufs - ABSOLUTE_GATE) / HISTOGRAM_STEP);
+			if (bin >= HISTOGRAM_BINS)
+				bin = HISTOGRAM_BINS - 1;
+			l->histogram[bin]++;
+			l->histogram_energy[bin] += block_energy;
+			update_integrated(l);
+		}
+	}
+}
+
+static inline double biquad(const struct biquad_s *f, double s[2], double x)
+{
+	/* Transposed direct form II */
+	double y = f->b0 * x + s[0];
+	s[0] = f->b1 * x - f->a1 * y + s[1];
+	s[1] = f->b2 * x - f->a2 * y;
+	return y;
+}
+
+void loudness_reset(loudness_t *l)
+{
+	memset(l->state, 0, sizeof(l->state));
+	memset(l->subblock_sum, 0, sizeof(l->subblock_sum));
+	memset(l->histogram, 0, sizeof(l->histogram));
+	memset(l->histogram_energy, 0, sizeof(l->histogram_energy));
+	l->subblock_pos = 0;
+	l->subblock_idx = 0;
+	l->nr_subblocks = 0;
+	l->values.momentary = -INFINITY;
+	l->values.short_term = -INFINITY;
+	l->values.integrated = -INFINITY;
+}
+
+loudness_t *loudness_create(uint32_t sample_rate)
+{
+	if (!sample_rate)
+		return NULL;
+
+	struct loudness_s *l = bzalloc(sizeof(struct loudness_s));
+	l->sample_rate = sample_rate;
+	l->subblock_frames = sample_rate / SUBBLOCKS_PER_SECOND;
+	init_filters(l);
+	loudness_reset(l);
+	return l;
+}
+
+void loudness_destroy(loudness_t *l)
+{
+	bfree(l);
+}
+
+void loudness_process(loudness_t *l, const float *const *planes, uint32_t nr_channels, size_t nr_frames)
+{
+	if (nr_channels > MAX_AUDIO_CHANNELS)
+		nr_channels = MAX_AUDIO_CHANNELS;
+
+	/* The weights and the blocks are not valid anymore. */
+	if (nr_channels != l->nr_channels) {
+		loudness_reset(l);
+		l->nr_channels = nr_channels;
+	}
+
+	size_t i = 0;
+	while (i < nr_frames) {
+		size_t n = l->subblock_frames - l->subblock_pos;
+		if (n > nr_frames - i)
+			n = nr_frames - i;
+
+		for (uint32_t ch = 0; ch < nr_channels; ch++) {
+			const float *x = planes[ch] + i;
+			double(*s)[2] = l->state[ch];
+			double sum = 0.0;
+			for (size_t j = 0; j < n; j++) {
+				double y = biquad(&l->rlb, s[1], biquad(&l->pre, s[0], x[j]));
+				sum += y * y;
+			}
+
+			/* Don't let NaN or infinity stay in the filter forever. */
+			if (!isfinite(sum)) {
+				memset(s, 0, sizeof(l->state[ch]));
+				continue;
+			}
+			l->subblock_sum[ch] += sum;
+		}
+
+		i += n;
+		l->subblock_pos += (uint32_t)n;
+		if (l->subblock_pos >= l->subblock_frames)
+			end_subblock(l);
+	}
+}
+
+void loudness_get_values(const loudness_t *l, struct loudness_values_s *values)
+{
+	*values = l->values;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct loudness_s loudness_t;
+
+/* Loudness in LUFS by EBU R128 (ITU-R BS.1770-4).
+ * A value is -infinity until enough samples are measured. */
+struct loudness_values_s
+{
+	float momentary;  // 400 ms window
+	float short_term; // 3 s window
+	float integrated; // gated, since the creation or the last reset
+};
+
+loudness_t *loudness_create(uint32_t sample_rate);
+void loudness_destroy(loudness_t *loudness);
+void loudness_reset(loudness_t *loudness);
+
+/* Feeds the planes of the samples. The channel weights are chosen from
+ * `nr_channels` assuming the speaker layouts of libobs.
+ * The memory usage doesn't depend on the length of the program. */
+void loudness_process(loudness_t *loudness, const float *const *planes, uint32_t nr_channels, size_t nr_frames);
+
+void loudness_get_values(const loudness_t *loudness, struct loudness_values_s *values);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,301 @@
+/*
+Graphical Volume Meter Plugin for OBS Studio
+Copyright (C) 2026 Norihiro Kamae <norihiro@nagater.net>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <obs.h>
+#include <util/threading.h>
+#include <util/darray.h>
+#include "plugin-macros.generated.h"
+#include "volmeter.h"
+#include "shared-volmeter.h"
+#include "util.h"
+
+struct shared_volmeter_s
+{
+	// key, holding a reference of `key.source`
+	struct shared_volmeter_key_s key;
+
+	// protected by registry_mutex
+	int refcnt;
+
+	/* References of the registry and of the audio capture callback of the
+	 * source. The callback is registered until the source is removed or
+	 * destroyed since the source calls it even after the weak reference
+	 * has expired, while its destruction is deferred. */
+	volatile long lifetime;
+	volatile long capturing;
+
+	volmeter_t *volmeter;
+
+	// thread: audio for the track, or the one outputting the audio of the source
+	DARRAY(uint8_t) buffer;
+};
+
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct shared_volmeter_s *) registry;
+
+static void push_audio_data(struct shared_volmeter_s *sv, const struct audio_data *data, bool muted)
+{
+	uint64_t ts = os_gettime_ns();
+
+	audio_t *audio = obs_get_audio();
+	if (!audio)
+		return;
+
+	uint32_t planes = (uint32_t)audio_output_get_planes(audio);
+
+	/* The volmeter handles any 16-byte misalignment by itself so that the
+	 * mix buffer can be passed as it is. Copy only if a plane is not even
+	 * aligned to a float. A muted source is measured as silence. */
+	bool need_copy = muted;
+	for (uint32_t i = 0; i < planes; i++) {
+		if ((uintptr_t)data->data[i] % sizeof(float))
+			need_copy = true;
+	}
+
+	if (!need_copy) {
+		volmeter_push_audio_data(sv->volmeter, data);
+		latency_stats_end(volmeter_get_latency_stats(sv->volmeter, VOLMETER_STAGE_AUDIO_CB), ts);
+		return;
+	}
+
+	struct audio_data ad = *data;
+	const size_t plane_size = sizeof(float) * data->frames;
+
+	da_resize(sv->buffer, plane_size * planes);
+
+	for (uint32_t i = 0; i < planes; i++) {
+		ad.data[i] = sv->buffer.array + plane_size * i;
+		if (muted)
+			memset(ad.data[i], 0, plane_size);
+		else
+			memcpy(ad.data[i], data->data[i], plane_size);
+	}
+	for (uint32_t i = planes; i < MAX_AV_PLANES; i++)
+		ad.data[i] = NULL;
+
+	volmeter_push_audio_data(sv->volmeter, &ad);
+	latency_stats_end(volmeter_get_latency_stats(sv->volmeter, VOLMETER_STAGE_AUDIO_CB), ts);
+}
+
+static void audio_cb(void *param, size_t mix_idx, struct audio_data *data)
+{
+	UNUSED_PARAMETER(mix_idx);
+	push_audio_data(param, data, false);
+}
+
+static void source_audio_cb(void *param, obs_source_t *source, const struct audio_data *data, bool muted)
+{
+	UNUSED_PARAMETER(source);
+	push_audio_data(param, data, muted);
+}
+
+static void shared_volmeter_free(struct shared_volmeter_s *sv)
+{
+	char context[64];
+	if (sv->key.source)
+		snprintf(context, sizeof(context), "shared volmeter source %p", (void *)sv->key.source);
+	else
+		snprintf(context, sizeof(context), "shared volmeter track %d", sv->key.track + 1);
+	volmeter_log_latency_stats(sv->volmeter, context);
+
+	volmeter_destroy(sv->volmeter);
+	obs_weak_source_release(sv->key.source);
+	da_free(sv->buffer);
+	bfree(sv);
+}
+
+static void shared_volmeter_unref(struct shared_volmeter_s *sv)
+{
+	if (os_atomic_dec_long(&sv->lifetime) == 0)
+		shared_volmeter_free(sv);
+}
+
+static void source_removed_cb(void *param, calldata_t *cd);
+
+/* Called with a reference of the source, or in its "remove" or "destroy"
+ * signal. Only the first call stops the capture. */
+static void stop_capture(struct shared_volmeter_s *sv, obs_source_t *source)
+{
+	if (!os_atomic_exchange_long(&sv->capturing, 0))
+		return;
+
+	/* The disconnection waits for the signal being emitted by another
+	 * thread. After returning from `obs_source_remove_audio_capture_callback`,
+	 * the source won't call the callback anymore. */
+	signal_handler_t *sh = obs_source_get_signal_handler(source);
+	signal_handler_disconnect(sh, "remove", source_removed_cb, sv);
+	signal_handler_disconnect(sh, "destroy", source_removed_cb, sv);
+	obs_source_remove_audio_capture_callback(source, source_audio_cb, sv);
+
+	shared_volmeter_unref(sv);
+}
+
+static void source_removed_cb(void *param, calldata_t *cd)
+{
+	stop_capture(param, calldata_ptr(cd, "source"));
+}
+
+static inline bool key_equals(const struct shared_volmeter_key_s *a, const struct shared_volmeter_key_s *b)
+{
+	if (a->source != b->source)
+		return false;
+	if (!a->source && a->track != b->track)
+		return false;
+	return a->peak_meter_type == b->peak_meter_type && a->loudness == b->loudness &&
+	       a->update_ms == b->update_ms;
+}
+
+static void key_log(const char *action, const struct shared_volmeter_key_s *key)
+{
+	char target[64];
+	if (key->source)
+		snprintf(target, sizeof(target), "source %p", (void *)key->source);
+	else
+		snprintf(target, sizeof(target), "track %d", key->track + 1);
+
+	blog(LOG_DEBUG, "%s shared volmeter for %s, peak_meter_type %d, loudness %d, update_ms %u", action, target,
+	     (int)key->peak_meter_type, (int)key->loudness, key->update_ms);
+}
+
+static struct shared_volmeter_s *shared_volmeter_create(const struct shared_volmeter_key_s *key)
+{
+	obs_source_t *source = NULL;
+	if (key->source) {
+		source = obs_weak_source_get_source(key->source);
+		if (!source)
+			return NULL;
+	}
+
+	volmeter_t *volmeter = volmeter_create();
+	if (!volmeter) {
+		obs_source_release(source);
+		return NULL;
+	}
+
+	volmeter_set_peak_meter_type(volmeter, key->peak_meter_type);
+	volmeter_set_loudness(volmeter, key->loudness);
+	volmeter_set_update_interval(volmeter, key->update_ms);
+
+	struct shared_volmeter_s *sv = bzalloc(sizeof(struct shared_volmeter_s));
+	sv->key = *key;
+	sv->volmeter = volmeter;
+	sv->lifetime = source ? 2 : 1;
+	sv->capturing = source ? 1 : 0;
+
+	key_log("Creating", key);
+	if (source) {
+		obs_weak_source_addref(sv->key.source);
+		signal_handler_t *sh = obs_source_get_signal_handler(source);
+		signal_handler_connect(sh, "remove", source_removed_cb, sv);
+		signal_handler_connect(sh, "destroy", source_removed_cb, sv);
+		obs_source_add_audio_capture_callback(source, source_audio_cb, sv);
+		obs_source_release(source);
+	}
+	else {
+		obs_add_raw_audio_callback(key->track, NULL, audio_cb, sv);
+	}
+
+	return sv;
+}
+
+/* Released from the registry. */
+static void shared_volmeter_destroy(struct shared_volmeter_s *sv)
+{
+	key_log("Destroying", &sv->key);
+
+	/* After returning from `obs_remove_raw_audio_callback`, the audio
+	 * thread won't call the callback anymore. If the source cannot be
+	 * referenced, it is being destroyed and the "destroy" signal will stop
+	 * the capture, which frees `sv` at last. */
+	if (sv->key.source) {
+		obs_source_t *source = obs_weak_source_get_source(sv->key.source);
+		if (source) {
+			stop_capture(sv, source);
+			obs_source_release(source);
+		}
+	}
+	else {
+		obs_remove_raw_audio_callback(sv->key.track, audio_cb, sv);
+	}
+
+	shared_volmeter_unref(sv);
+}
+
+volmeter_t *shared_volmeter_get(const struct shared_volmeter_key_s *key)
+{
+	if (!key->source && (key->track < 0 || MAX_AUDIO_MIXES <= key->track))
+		return NULL;
+
+	volmeter_t *volmeter = NULL;
+
+	pthread_mutex_lock(&registry_mutex);
+
+	for (size_t i = 0; i < registry.num; i++) {
+		struct shared_volmeter_s *sv = registry.array[i];
+		if (key_equals(&sv->key, key)) {
+			sv->refcnt++;
+			volmeter = sv->volmeter;
+			break;
+		}
+	}
+
+	if (!volmeter) {
+		struct shared_volmeter_s *sv = shared_volmeter_create(key);
+		if (sv) {
+			sv->refcnt = 1;
+			da_push_back(registry, &sv);
+			volmeter = sv->volmeter;
+		}
+	}
+
+	pthread_mutex_unlock(&registry_mutex);
+
+	return volmeter;
+}
+
+void shared_volmeter_release(volmeter_t *volmeter)
+{
+	if (!volmeter)
+		return;
+
+	struct shared_volmeter_s *sv_destroy = NULL;
+
+	pthread_mutex_lock(&registry_mutex);
+
+	for (size_t i = 0; i < registry.num; i++) {
+		struct shared_volmeter_s *sv = registry.array[i];
+		if (sv->volmeter != volmeter)
+			continue;
+
+		if (--sv->refcnt == 0) {
+			da_erase(registry, i);
+			sv_destroy = sv;
+		}
+		break;
+	}
+
+	if (!registry.num)
+		da_free(registry);
+
+	pthread_mutex_unlock(&registry_mutex);
+
+	if (sv_destroy)
+		shared_volmeter_destroy(sv_destroy);
+}
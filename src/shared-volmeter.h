@@ -0,0 +1,28 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* What a shared volmeter analyzes and how.
+ * If `source` is set, the audio of the source is analyzed instead of the mix
+ * `track`. */
+struct shared_volmeter_key_s
+{
+	int track;
+	obs_weak_source_t *source;
+	enum volmeter_peak_type peak_meter_type;
+	bool loudness;
+	unsigned int update_ms; // publish every packet if 0
+};
+
+/* Returns a volmeter for `key`.
+ * The volmeter is shared by all callers requesting the same key so that the
+ * audio data is analyzed only once per mix or source.
+ * The caller has to call `shared_volmeter_release` when it is not needed. */
+volmeter_t *shared_volmeter_get(const struct shared_volmeter_key_s *key);
+void shared_volmeter_release(volmeter_t *volmeter);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,11 +1,35 @@
 #pragma once
 
+#include <graphics/vec2.h>
+#include <graphics/vec3.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 gs_effect_t *create_effect_from_module_file(const char *basename);
 
+/* Sets a rectangle of 2 triangles to be drawn by GS_TRIS. */
+static inline void set_v3_rect(struct vec3 *a, float x, float y, float w, float h)
+{
+	vec3_set(a + 0, x, y, 0.0f);
+	vec3_set(a + 1, x + w, y, 0.0f);
+	vec3_set(a + 2, x, y + h, 0.0f);
+	vec3_set(a + 3, x, y + h, 0.0f);
+	vec3_set(a + 4, x + w, y, 0.0f);
+	vec3_set(a + 5, x + w, y + h, 0.0f);
+}
+
+static inline void set_v2_uv(struct vec2 *a, float u, float v, float u2, float v2)
+{
+	vec2_set(a + 0, u, v);
+	vec2_set(a + 1, u2, v);
+	vec2_set(a + 2, u, v2);
+	vec2_set(a + 3, u, v2);
+	vec2_set(a + 4, u2, v);
+	vec2_set(a + 5, u2, v2);
+}
+
 #ifdef WITH_ASSERT_THREAD
 #define ASSERT_THREAD(type)                                                                     \
 	do {                                                                                    \
@@ -28,18 +52,6 @@ gs_effect_t *create_effect_from_module_file(const char *basename);
 #define ASSERT_GRAPHICS_CONTEXT()
 #endif
 
-static inline enum obs_peak_meter_type peak_meter_type_from_int(int value)
-{
-	switch (value) {
-	case 0:
-		return SAMPLE_PEAK_METER;
-	case 1:
-		return TRUE_PEAK_METER;
-	default:
-		return SAMPLE_PEAK_METER;
-	}
-}
-
 #ifdef __cplusplus
 }
 #endif
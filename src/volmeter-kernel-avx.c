@@ -0,0 +1,357 @@
+/*
+Copyright (C) 2014 by Leonhard Oelke <leonhard@in-verted.de>
+Modified by Norihiro Kamae <norihiro@nagater.net>
+- Copied from obs-studio/libobs/obs-audio-controls.c
+- Ported the SSE kernels to AVX2 and AVX-512
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "volmeter-kernel.h"
+
+#ifdef VOLMETER_KERNEL_X86
+
+#include <string.h>
+#include <math.h>
+#include <immintrin.h>
+
+/* The functions below are compiled for AVX2 or AVX-512 regardless of the
+ * compiler flags, and are called only when the CPU supports them. */
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx2,avx512f")))
+#else
+#define TARGET_AVX2
+#define TARGET_AVX512
+#endif
+
+TARGET_AVX2 static inline __m256 abs_ps_avx2(__m256 x)
+{
+	return _mm256_andnot_ps(_mm256_set1_ps(-0.f), x);
+}
+
+/* Same as the SSE kernel, the peak is taken as `max(x, peak)` so that NaN in
+ * `x` is ignored.
+ */
+
+/* sum += x for each lane by the compensated (Kahan) summation.
+ * Same as the SSE kernel, c is kept 0 once the sum is infinity.
+ */
+TARGET_AVX2 static inline void kahan_add_ps_avx2(__m256 *sum, __m256 *c, __m256 x)
+{
+	__m256 y = _mm256_sub_ps(x, *c);
+	__m256 t = _mm256_add_ps(*sum, y);
+	__m256 finite = _mm256_cmp_ps(t, _mm256_set1_ps(INFINITY), _CMP_LT_OQ);
+	*c = _mm256_and_ps(finite, _mm256_sub_ps(_mm256_sub_ps(t, *sum), y));
+	*sum = t;
+}
+
+TARGET_AVX2 static inline double hsum_kahan_ps_avx2(__m256 sum, __m256 c)
+{
+	float sum_mem[8], c_mem[8];
+	_mm256_storeu_ps(sum_mem, sum);
+	_mm256_storeu_ps(c_mem, c);
+
+	double r = 0.0;
+	for (int i = 0; i < 8; i++)
+		r += (double)sum_mem[i] - (double)c_mem[i];
+	return r;
+}
+
+TARGET_AVX2 static inline float hmax_ps_avx2(__m256 x)
+{
+	__m128 r = _mm_max_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1));
+	r = _mm_max_ps(r, _mm_movehl_ps(r, r));
+	r = _mm_max_ss(r, _mm_shuffle_ps(r, r, _MM_SHUFFLE(1, 1, 1, 1)));
+	return _mm_cvtss_f32(r);
+}
+
+/* Takes the true peak and the sum of the squares of the 8 samples at `p`.
+ * The 3 samples before `p` have to be readable. */
+TARGET_AVX2 static inline __m256 true_peak_block_avx2(__m256 peak, const float *p, const __m256 c[4][4], __m256 *sum,
+						     __m256 *comp)
+{
+	__m256 x0 = _mm256_loadu_ps(p - 3);
+	__m256 x1 = _mm256_loadu_ps(p - 2);
+	__m256 x2 = _mm256_loadu_ps(p - 1);
+	__m256 x3 = _mm256_loadu_ps(p);
+
+	peak = _mm256_max_ps(abs_ps_avx2(x3), peak);
+	kahan_add_ps_avx2(sum, comp, _mm256_mul_ps(x3, x3));
+
+	for (int k = 0; k < 4; k++) {
+		__m256 y = _mm256_mul_ps(x0, c[k][0]);
+		y = _mm256_add_ps(y, _mm256_mul_ps(x1, c[k][1]));
+		y = _mm256_add_ps(y, _mm256_mul_ps(x2, c[k][2]));
+		y = _mm256_add_ps(y, _mm256_mul_ps(x3, c[k][3]));
+		peak = _mm256_max_ps(abs_ps_avx2(y), peak);
+	}
+
+	return peak;
+}
+
+TARGET_AVX2 static float true_peak_avx2(const float prev[4], const float *samples, size_t nr_samples, float *sum_squares)
+{
+	__m256 c[4][4];
+	for (int k = 0; k < 4; k++) {
+		for (int l = 0; l < 4; l++)
+			c[k][l] = _mm256_set1_ps(volmeter_true_peak_coefs[k][l]);
+	}
+
+	__m256 peak = _mm256_set1_ps(volmeter_prev_peak(prev));
+	__m256 sum = _mm256_setzero_ps();
+	__m256 comp = _mm256_setzero_ps();
+	size_t i = 0;
+
+	if (nr_samples >= 8) {
+		/* The first block needs the previous samples in front. */
+		float head[3 + 8];
+		memcpy(head, prev + 1, sizeof(float) * 3);
+		memcpy(head + 3, samples, sizeof(float) * 8);
+		peak = true_peak_block_avx2(peak, head + 3, c, &sum, &comp);
+
+		for (i = 8; i + 8 <= nr_samples; i += 8)
+			peak = true_peak_block_avx2(peak, samples + i, c, &sum, &comp);
+	}
+
+	double sum_d = hsum_kahan_ps_avx2(sum, comp);
+	float r = volmeter_true_peak_scalar(hmax_ps_avx2(peak), prev, samples, i, nr_samples, &sum_d);
+	*sum_squares = (float)sum_d;
+	return r;
+}
+
+TARGET_AVX2 static float sample_peak_avx2(const float prev[4], const float *samples, size_t nr_samples,
+					  float *sum_squares)
+{
+	__m256 peak = _mm256_set1_ps(volmeter_prev_peak(prev));
+	__m256 sum = _mm256_setzero_ps();
+	__m256 comp = _mm256_setzero_ps();
+	size_t i = 0;
+	for (; i + 8 <= nr_samples; i += 8) {
+		__m256 x = _mm256_loadu_ps(samples + i);
+		peak = _mm256_max_ps(abs_ps_avx2(x), peak);
+		kahan_add_ps_avx2(&sum, &comp, _mm256_mul_ps(x, x));
+	}
+
+	double sum_d = hsum_kahan_ps_avx2(sum, comp);
+	float r = volmeter_sample_peak_scalar(hmax_ps_avx2(peak), samples, i, nr_samples, &sum_d);
+	*sum_squares = (float)sum_d;
+	return r;
+}
+
+/* Polyphase FIR true peak of the 8 samples at `p`.
+ * `VOLMETER_FIR_TAPS - 1` samples before `p` have to be readable. */
+TARGET_AVX2 static inline __m256 fir_true_peak_block_avx2(__m256 peak, const float *p, int nr_phases,
+							  const __m256 c[VOLMETER_FIR_MAX_PHASES][VOLMETER_FIR_TAPS],
+							  __m256 *sum, __m256 *comp)
+{
+	__m256 x[VOLMETER_FIR_TAPS];
+	for (int k = 0; k < VOLMETER_FIR_TAPS; k++)
+		x[k] = _mm256_loadu_ps(p - (VOLMETER_FIR_TAPS - 1) + k);
+
+	__m256 s = x[VOLMETER_FIR_TAPS - 1];
+	peak = _mm256_max_ps(abs_ps_avx2(s), peak);
+	kahan_add_ps_avx2(sum, comp, _mm256_mul_ps(s, s));
+
+	for (int ph = 0; ph < nr_phases; ph++) {
+		__m256 y = _mm256_mul_ps(x[0], c[ph][0]);
+		for (int k = 1; k < VOLMETER_FIR_TAPS; k++)
+			y = _mm256_add_ps(y, _mm256_mul_ps(x[k], c[ph][k]));
+		peak = _mm256_max_ps(abs_ps_avx2(y), peak);
+	}
+
+	return peak;
+}
+
+TARGET_AVX2 static float fir_true_peak_avx2(const struct volmeter_fir_s *fir, const float prev[VOLMETER_HISTORY],
+					    const float *samples, size_t nr_samples, float *sum_squares)
+{
+	__m256 c[VOLMETER_FIR_MAX_PHASES][VOLMETER_FIR_TAPS];
+	for (int ph = 0; ph < fir->nr_phases; ph++) {
+		for (int k = 0; k < VOLMETER_FIR_TAPS; k++)
+			c[ph][k] = _mm256_set1_ps(fir->coefs[ph][k]);
+	}
+
+	/* The first samples need the previous samples. */
+	double sum_d = 0.0;
+	size_t i = nr_samples < VOLMETER_HISTORY ? nr_samples : VOLMETER_HISTORY;
+	float r = volmeter_fir_true_peak_scalar(0.0f, fir, prev, samples, 0, i, &sum_d);
+
+	__m256 peak = _mm256_setzero_ps();
+	__m256 sum = _mm256_setzero_ps();
+	__m256 comp = _mm256_setzero_ps();
+	for (; i + 8 <= nr_samples; i += 8)
+		peak = fir_true_peak_block_avx2(peak, samples + i, fir->nr_phases, c, &sum, &comp);
+
+	sum_d += hsum_kahan_ps_avx2(sum, comp);
+	r = volmeter_fir_true_peak_scalar(fmaxf(r, hmax_ps_avx2(peak)), fir, prev, samples, i, nr_samples, &sum_d);
+	*sum_squares = (float)sum_d;
+	return r;
+}
+
+TARGET_AVX512 static inline void kahan_add_ps_avx512(__m512 *sum, __m512 *c, __m512 x)
+{
+	__m512 y = _mm512_sub_ps(x, *c);
+	__m512 t = _mm512_add_ps(*sum, y);
+	__mmask16 finite = _mm512_cmp_ps_mask(t, _mm512_set1_ps(INFINITY), _CMP_LT_OQ);
+	*c = _mm512_maskz_sub_ps(finite, _mm512_sub_ps(t, *sum), y);
+	*sum = t;
+}
+
+TARGET_AVX512 static inline double hsum_kahan_ps_avx512(__m512 sum, __m512 c)
+{
+	float sum_mem[16], c_mem[16];
+	_mm512_storeu_ps(sum_mem, sum);
+	_mm512_storeu_ps(c_mem, c);
+
+	double r = 0.0;
+	for (int i = 0; i < 16; i++)
+		r += (double)sum_mem[i] - (double)c_mem[i];
+	return r;
+}
+
+TARGET_AVX512 static inline __m512 true_peak_block_avx512(__m512 peak, const float *p, const __m512 c[4][4],
+							 __m512 *sum, __m512 *comp)
+{
+	__m512 x0 = _mm512_loadu_ps(p - 3);
+	__m512 x1 = _mm512_loadu_ps(p - 2);
+	__m512 x2 = _mm512_loadu_ps(p - 1);
+	__m512 x3 = _mm512_loadu_ps(p);
+
+	peak = _mm512_max_ps(_mm512_abs_ps(x3), peak);
+	kahan_add_ps_avx512(sum, comp, _mm512_mul_ps(x3, x3));
+
+	for (int k = 0; k < 4; k++) {
+		__m512 y = _mm512_mul_ps(x0, c[k][0]);
+		y = _mm512_add_ps(y, _mm512_mul_ps(x1, c[k][1]));
+		y = _mm512_add_ps(y, _mm512_mul_ps(x2, c[k][2]));
+		y = _mm512_add_ps(y, _mm512_mul_ps(x3, c[k][3]));
+		peak = _mm512_max_ps(_mm512_abs_ps(y), peak);
+	}
+
+	return peak;
+}
+
+TARGET_AVX512 static float true_peak_avx512(const float prev[4], const float *samples, size_t nr_samples,
+					    float *sum_squares)
+{
+	__m512 c[4][4];
+	for (int k = 0; k < 4; k++) {
+		for (int l = 0; l < 4; l++)
+			c[k][l] = _mm512_set1_ps(volmeter_true_peak_coefs[k][l]);
+	}
+
+	__m512 peak = _mm512_set1_ps(volmeter_prev_peak(prev));
+	__m512 sum = _mm512_setzero_ps();
+	__m512 comp = _mm512_setzero_ps();
+	size_t i = 0;
+
+	if (nr_samples >= 16) {
+		float head[3 + 16];
+		memcpy(head, prev + 1, sizeof(float) * 3);
+		memcpy(head + 3, samples, sizeof(float) * 16);
+		peak = true_peak_block_avx512(peak, head + 3, c, &sum, &comp);
+
+		for (i = 16; i + 16 <= nr_samples; i += 16)
+			peak = true_peak_block_avx512(peak, samples + i, c, &sum, &comp);
+	}
+
+	double sum_d = hsum_kahan_ps_avx512(sum, comp);
+	float r = volmeter_true_peak_scalar(_mm512_reduce_max_ps(peak), prev, samples, i, nr_samples, &sum_d);
+	*sum_squares = (float)sum_d;
+	return r;
+}
+
+TARGET_AVX512 static float sample_peak_avx512(const float prev[4], const float *samples, size_t nr_samples,
+					      float *sum_squares)
+{
+	__m512 peak = _mm512_set1_ps(volmeter_prev_peak(prev));
+	__m512 sum = _mm512_setzero_ps();
+	__m512 comp = _mm512_setzero_ps();
+	size_t i = 0;
+	for (; i + 16 <= nr_samples; i += 16) {
+		__m512 x = _mm512_loadu_ps(samples + i);
+		peak = _mm512_max_ps(_mm512_abs_ps(x), peak);
+		kahan_add_ps_avx512(&sum, &comp, _mm512_mul_ps(x, x));
+	}
+
+	double sum_d = hsum_kahan_ps_avx512(sum, comp);
+	float r = volmeter_sample_peak_scalar(_mm512_reduce_max_ps(peak), samples, i, nr_samples, &sum_d);
+	*sum_squares = (float)sum_d;
+	return r;
+}
+
+TARGET_AVX512 static inline __m512 fir_true_peak_block_avx512(__m512 peak, const float *p, int nr_phases,
+							      const __m512 c[VOLMETER_FIR_MAX_PHASES][VOLMETER_FIR_TAPS],
+							      __m512 *sum, __m512 *comp)
+{
+	__m512 x[VOLMETER_FIR_TAPS];
+	for (int k = 0; k < VOLMETER_FIR_TAPS; k++)
+		x[k] = _mm512_loadu_ps(p - (VOLMETER_FIR_TAPS - 1) + k);
+
+	__m512 s = x[VOLMETER_FIR_TAPS - 1];
+	peak = _mm512_max_ps(_mm512_abs_ps(s), peak);
+	kahan_add_ps_avx512(sum, comp, _mm512_mul_ps(s, s));
+
+	for (int ph = 0; ph < nr_phases; ph++) {
+		__m512 y = _mm512_mul_ps(x[0], c[ph][0]);
+		for (int k = 1; k < VOLMETER_FIR_TAPS; k++)
+			y = _mm512_add_ps(y, _mm512_mul_ps(x[k], c[ph][k]));
+		peak = _mm512_max_ps(_mm512_abs_ps(y), peak);
+	}
+
+	return peak;
+}
+
+TARGET_AVX512 static float fir_true_peak_avx512(const struct volmeter_fir_s *fir, const float prev[VOLMETER_HISTORY],
+						const float *samples, size_t nr_samples, float *sum_squares)
+{
+	__m512 c[VOLMETER_FIR_MAX_PHASES][VOLMETER_FIR_TAPS];
+	for (int ph = 0; ph < fir->nr_phases; ph++) {
+		for (int k = 0; k < VOLMETER_FIR_TAPS; k++)
+			c[ph][k] = _mm512_set1_ps(fir->coefs[ph][k]);
+	}
+
+	double sum_d = 0.0;
+	size_t i = nr_samples < VOLMETER_HISTORY ? nr_samples : VOLMETER_HISTORY;
+	float r = volmeter_fir_true_peak_scalar(0.0f, fir, prev, samples, 0, i, &sum_d);
+
+	__m512 peak = _mm512_setzero_ps();
+	__m512 sum = _mm512_setzero_ps();
+	__m512 comp = _mm512_setzero_ps();
+	for (; i + 16 <= nr_samples; i += 16)
+		peak = fir_true_peak_block_avx512(peak, samples + i, fir->nr_phases, c, &sum, &comp);
+
+	sum_d += hsum_kahan_ps_avx512(sum, comp);
+	r = volmeter_fir_true_peak_scalar(fmaxf(r, _mm512_reduce_max_ps(peak)), fir, prev, samples, i, nr_samples,
+					  &sum_d);
+	*sum_squares = (float)sum_d;
+	return r;
+}
+
+const struct volmeter_kernel_s volmeter_kernel_avx2 = {
+	.name = "AVX2",
+	.sample_peak = sample_peak_avx2,
+	.true_peak = true_peak_avx2,
+	.fir_true_peak = fir_true_peak_avx2,
+};
+
+const struct volmeter_kernel_s volmeter_kernel_avx512 = {
+	.name = "AVX-512",
+	.sample_peak = sample_peak_avx512,
+	.true_peak = true_peak_avx512,
+	.fir_true_peak = fir_true_peak_avx512,
+};
+
+#endif // VOLMETER_KERNEL_X86
@@ -0,0 +1,53 @@
+/*
+Copyright (C) 2014 by Leonhard Oelke <leonhard@in-verted.de>
+Modified by Norihiro Kamae <norihiro@nagater.net>
+- Copied from obs-studio/libobs/obs-audio-controls.c
+- Wrote the SSE kernels in plain C as the reference
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "volmeter-kernel.h"
+
+static float true_peak_c(const float prev[4], const float *samples, size_t nr_samples, float *sum_squares)
+{
+	double sum = 0.0;
+	float peak = volmeter_true_peak_scalar(volmeter_prev_peak(prev), prev, samples, 0, nr_samples, &sum);
+	*sum_squares = (float)sum;
+	return peak;
+}
+
+static float sample_peak_c(const float prev[4], const float *samples, size_t nr_samples, float *sum_squares)
+{
+	double sum = 0.0;
+	float peak = volmeter_sample_peak_scalar(volmeter_prev_peak(prev), samples, 0, nr_samples, &sum);
+	*sum_squares = (float)sum;
+	return peak;
+}
+
+static float fir_true_peak_c(const struct volmeter_fir_s *fir, const float prev[VOLMETER_HISTORY], const float *samples,
+			     size_t nr_samples, float *sum_squares)
+{
+	double sum = 0.0;
+	float peak = volmeter_fir_true_peak_scalar(0.0f, fir, prev, samples, 0, nr_samples, &sum);
+	*sum_squares = (float)sum;
+	return peak;
+}
+
+const struct volmeter_kernel_s volmeter_kernel_c = {
+	.name = "C",
+	.sample_peak = sample_peak_c,
+	.true_peak = true_peak_c,
+	.fir_true_peak = fir_true_peak_c,
+};
@@ -0,0 +1,173 @@
+/*
+Copyright (C) 2014 by Leonhard Oelke <leonhard@in-verted.de>
+Modified by Norihiro Kamae <norihiro@nagater.net>
+- Copied from obs-studio/libobs/obs-audio-controls.c
+- Ported the SSE kernels to NEON
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "volmeter-kernel.h"
+
+#ifdef VOLMETER_KERNEL_NEON
+
+#include <string.h>
+#include <arm_neon.h>
+
+/* The peak is taken by `vmaxnmq_f32`, which ignores NaN same as `fmaxf` and
+ * the other kernels. `vmaxq_f32` would propagate NaN.
+ */
+
+/* sum += x for each lane by the compensated (Kahan) summation.
+ * Same as the SSE kernel, c is kept 0 once the sum is infinity.
+ */
+static inline void kahan_add_neon(float32x4_t *sum, float32x4_t *c, float32x4_t x)
+{
+	float32x4_t y = vsubq_f32(x, *c);
+	float32x4_t t = vaddq_f32(*sum, y);
+	uint32x4_t finite = vcltq_f32(t, vdupq_n_f32(INFINITY));
+	*c = vreinterpretq_f32_u32(vandq_u32(finite, vreinterpretq_u32_f32(vsubq_f32(vsubq_f32(t, *sum), y))));
+	*sum = t;
+}
+
+static inline double hsum_kahan_neon(float32x4_t sum, float32x4_t c)
+{
+	float sum_mem[4], c_mem[4];
+	vst1q_f32(sum_mem, sum);
+	vst1q_f32(c_mem, c);
+
+	double r = 0.0;
+	for (int i = 0; i < 4; i++)
+		r += (double)sum_mem[i] - (double)c_mem[i];
+	return r;
+}
+
+/* Takes the true peak and the sum of the squares of the 4 samples at `p`.
+ * The 3 samples before `p` have to be readable. */
+static inline float32x4_t true_peak_block_neon(float32x4_t peak, const float *p, float32x4_t *sum, float32x4_t *comp)
+{
+	float32x4_t x0 = vld1q_f32(p - 3);
+	float32x4_t x1 = vld1q_f32(p - 2);
+	float32x4_t x2 = vld1q_f32(p - 1);
+	float32x4_t x3 = vld1q_f32(p);
+
+	peak = vmaxnmq_f32(peak, vabsq_f32(x3));
+	kahan_add_neon(sum, comp, vmulq_f32(x3, x3));
+
+	for (int k = 0; k < 4; k++) {
+		const float *c = volmeter_true_peak_coefs[k];
+		float32x4_t y = vmulq_n_f32(x0, c[0]);
+		y = vaddq_f32(y, vmulq_n_f32(x1, c[1]));
+		y = vaddq_f32(y, vmulq_n_f32(x2, c[2]));
+		y = vaddq_f32(y, vmulq_n_f32(x3, c[3]));
+		peak = vmaxnmq_f32(peak, vabsq_f32(y));
+	}
+
+	return peak;
+}
+
+static float true_peak_neon(const float prev[4], const float *samples, size_t nr_samples, float *sum_squares)
+{
+	float32x4_t peak = vdupq_n_f32(volmeter_prev_peak(prev));
+	float32x4_t sum = vdupq_n_f32(0.0f);
+	float32x4_t comp = vdupq_n_f32(0.0f);
+	size_t i = 0;
+
+	if (nr_samples >= 4) {
+		/* The first block needs the previous samples in front. */
+		float head[3 + 4];
+		memcpy(head, prev + 1, sizeof(float) * 3);
+		memcpy(head + 3, samples, sizeof(float) * 4);
+		peak = true_peak_block_neon(peak, head + 3, &sum, &comp);
+
+		for (i = 4; i + 4 <= nr_samples; i += 4)
+			peak = true_peak_block_neon(peak, samples + i, &sum, &comp);
+	}
+
+	double sum_d = hsum_kahan_neon(sum, comp);
+	float r = volmeter_true_peak_scalar(vmaxnmvq_f32(peak), prev, samples, i, nr_samples, &sum_d);
+	*sum_squares = (float)sum_d;
+	return r;
+}
+
+static float sample_peak_neon(const float prev[4], const float *samples, size_t nr_samples, float *sum_squares)
+{
+	float32x4_t peak = vdupq_n_f32(volmeter_prev_peak(prev));
+	float32x4_t sum = vdupq_n_f32(0.0f);
+	float32x4_t comp = vdupq_n_f32(0.0f);
+	size_t i = 0;
+	for (; i + 4 <= nr_samples; i += 4) {
+		float32x4_t x = vld1q_f32(samples + i);
+		peak = vmaxnmq_f32(peak, vabsq_f32(x));
+		kahan_add_neon(&sum, &comp, vmulq_f32(x, x));
+	}
+
+	double sum_d = hsum_kahan_neon(sum, comp);
+	float r = volmeter_sample_peak_scalar(vmaxnmvq_f32(peak), samples, i, nr_samples, &sum_d);
+	*sum_squares = (float)sum_d;
+	return r;
+}
+
+/* Polyphase FIR true peak of the 4 samples at `p`.
+ * `VOLMETER_FIR_TAPS - 1` samples before `p` have to be readable. */
+static inline float32x4_t fir_true_peak_block_neon(float32x4_t peak, const float *p, const struct volmeter_fir_s *fir,
+						   float32x4_t *sum, float32x4_t *comp)
+{
+	float32x4_t x[VOLMETER_FIR_TAPS];
+	for (int k = 0; k < VOLMETER_FIR_TAPS; k++)
+		x[k] = vld1q_f32(p - (VOLMETER_FIR_TAPS - 1) + k);
+
+	float32x4_t s = x[VOLMETER_FIR_TAPS - 1];
+	peak = vmaxnmq_f32(peak, vabsq_f32(s));
+	kahan_add_neon(sum, comp, vmulq_f32(s, s));
+
+	for (int ph = 0; ph < fir->nr_phases; ph++) {
+		const float *c = fir->coefs[ph];
+		float32x4_t y = vmulq_n_f32(x[0], c[0]);
+		for (int k = 1; k < VOLMETER_FIR_TAPS; k++)
+			y = vaddq_f32(y, vmulq_n_f32(x[k], c[k]));
+		peak = vmaxnmq_f32(peak, vabsq_f32(y));
+	}
+
+	return peak;
+}
+
+static float fir_true_peak_neon(const struct volmeter_fir_s *fir, const float prev[VOLMETER_HISTORY],
+				const float *samples, size_t nr_samples, float *sum_squares)
+{
+	/* The first samples need the previous samples. */
+	double sum_d = 0.0;
+	size_t i = nr_samples < VOLMETER_HISTORY ? nr_samples : VOLMETER_HISTORY;
+	float r = volmeter_fir_true_peak_scalar(0.0f, fir, prev, samples, 0, i, &sum_d);
+
+	float32x4_t peak = vdupq_n_f32(0.0f);
+	float32x4_t sum = vdupq_n_f32(0.0f);
+	float32x4_t comp = vdupq_n_f32(0.0f);
+	for (; i + 4 <= nr_samples; i += 4)
+		peak = fir_true_peak_block_neon(peak, samples + i, fir, &sum, &comp);
+
+	sum_d += hsum_kahan_neon(sum, comp);
+	r = volmeter_fir_true_peak_scalar(fmaxf(r, vmaxnmvq_f32(peak)), fir, prev, samples, i, nr_samples, &sum_d);
+	*sum_squares = (float)sum_d;
+	return r;
+}
+
+const struct volmeter_kernel_s volmeter_kernel_neon = {
+	.name = "NEON",
+	.sample_peak = sample_peak_neon,
+	.true_peak = true_peak_neon,
+	.fir_true_peak = fir_true_peak_neon,
+};
+
+#endif // VOLMETER_KERNEL_NEON
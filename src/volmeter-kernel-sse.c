@@ -0,0 +1,300 @@
+/*
+Copyright (C) 2014 by Leonhard Oelke <leonhard@in-verted.de>
+Modified by Norihiro Kamae <norihiro@nagater.net>
+- Copied from obs-studio/libobs/obs-audio-controls.c
+- Split the SSE kernels from volmeter.c
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "volmeter-kernel.h"
+
+#ifdef VOLMETER_KERNEL_X86
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <xmmintrin.h>
+
+/* msb(h, g, f, e) lsb(d, c, b, a)   -->  msb(h, h, g, f) lsb(e, d, c, b)
+ */
+#define SHIFT_RIGHT_2PS(msb, lsb)                                               \
+	{                                                                       \
+		__m128 tmp = _mm_shuffle_ps(lsb, msb, _MM_SHUFFLE(0, 0, 3, 3)); \
+		lsb = _mm_shuffle_ps(lsb, tmp, _MM_SHUFFLE(2, 1, 2, 1));        \
+		msb = _mm_shuffle_ps(msb, msb, _MM_SHUFFLE(3, 3, 2, 1));        \
+	}
+
+/* Whether the pointer can be used for `_mm_load_ps`.
+ */
+#define IS_ALIGNED_PS(ptr) ((uintptr_t)(ptr) % 16 == 0)
+
+/* x(d, c, b, a) --> (|d|, |c|, |b|, |a|)
+ */
+#define abs_ps(v) _mm_andnot_ps(_mm_set1_ps(-0.f), v)
+
+/* The peak is always taken as `_mm_max_ps(x, peak)`, which returns `peak` if
+ * `x` is NaN, so that NaN is ignored same as `fmaxf` of the scalar code.
+ */
+
+/* Take cross product of a vector with a matrix resulting in vector.
+ */
+#define VECTOR_MATRIX_CROSS_PS(out, v, m0, m1, m2, m3)    \
+	{                                                 \
+		out = _mm_mul_ps(v, m0);                  \
+		__m128 mul1 = _mm_mul_ps(v, m1);          \
+		__m128 mul2 = _mm_mul_ps(v, m2);          \
+		__m128 mul3 = _mm_mul_ps(v, m3);          \
+                                                          \
+		_MM_TRANSPOSE4_PS(out, mul1, mul2, mul3); \
+                                                          \
+		out = _mm_add_ps(out, mul1);              \
+		out = _mm_add_ps(out, mul2);              \
+		out = _mm_add_ps(out, mul3);              \
+	}
+
+/* sum += x for each lane by the compensated (Kahan) summation,
+ * c holds the lost low-order part.
+ * Once the sum is infinity, c is kept 0 so that the sum stays infinity
+ * instead of turning into NaN by `inf - inf`.
+ */
+#define KAHAN_ADD_PS(sum, c, x)                                            \
+	{                                                                  \
+		__m128 y = _mm_sub_ps(x, c);                               \
+		__m128 t = _mm_add_ps(sum, y);                             \
+		__m128 finite = _mm_cmplt_ps(t, _mm_set1_ps(INFINITY));    \
+		c = _mm_and_ps(finite, _mm_sub_ps(_mm_sub_ps(t, sum), y)); \
+		sum = t;                                                   \
+	}
+
+/* x4(d, c, b, a)  -->  max(a, b, c, d)
+ */
+#define hmax_ps(r, x4)                     \
+	do {                               \
+		float x4_mem[4];           \
+		_mm_storeu_ps(x4_mem, x4); \
+		r = x4_mem[0];             \
+		r = fmaxf(r, x4_mem[1]);   \
+		r = fmaxf(r, x4_mem[2]);   \
+		r = fmaxf(r, x4_mem[3]);   \
+	} while (false)
+
+static inline float hsum_kahan_ps(__m128 sum, __m128 c)
+{
+	float sum_mem[4], c_mem[4];
+	_mm_storeu_ps(sum_mem, sum);
+	_mm_storeu_ps(c_mem, c);
+
+	double r = 0.0;
+	for (int i = 0; i < 4; i++)
+		r += (double)sum_mem[i] - (double)c_mem[i];
+	return (float)r;
+}
+
+/* Shift in a single sample and take the peak of the sample itself and the
+ * points interpolated with it. Used for the samples that are not processed by
+ * the aligned loop.
+ */
+#define TRUE_PEAK_SHIFT_IN_1(peak, sum, c, work, sample)                     \
+	{                                                                    \
+		__m128 new_work = _mm_set1_ps(sample);                       \
+		__m128 intrp_samples;                                        \
+                                                                             \
+		peak = _mm_max_ps(abs_ps(new_work), peak);                   \
+		KAHAN_ADD_PS(sum, c, _mm_set_ss((sample) * (sample)));       \
+                                                                             \
+		SHIFT_RIGHT_2PS(new_work, work);                             \
+		VECTOR_MATRIX_CROSS_PS(intrp_samples, work, m3, m1, p1, p3); \
+		peak = _mm_max_ps(abs_ps(intrp_samples), peak);              \
+	}
+
+#define SAMPLE_PEAK_1(peak, sum, c, sample)                            \
+	{                                                              \
+		peak = _mm_max_ps(abs_ps(_mm_set1_ps(sample)), peak);  \
+		KAHAN_ADD_PS(sum, c, _mm_set_ss((sample) * (sample))); \
+	}
+
+/* Calculate the true peak over a set of samples.
+ * The algorithm implements 5x oversampling by using Whittaker-Shannon
+ * interpolation over four samples.
+ *
+ * The four samples have location t=-1.5, -0.5, +0.5, +1.5
+ * The oversamples are taken at locations t=-0.3, -0.1, +0.1, +0.3
+ *
+ * The samples don't need to be aligned and the number of the samples doesn't
+ * need to be a multiple of 4. Leading samples before a 16-byte boundary and
+ * trailing samples after the last set of 4 samples are shifted in one by one,
+ * the rest are processed by aligned loads.
+ *
+ * The sum of the squares is calculated in the same pass so that the samples
+ * are read only once.
+ *
+ * @param prev              Last 4 samples from the previous iteration.
+ * @param samples           The samples to find the peak in.
+ * @param nr_samples        Number of the samples.
+ * @param sum_squares       Returns the sum of the squares of the samples.
+ * @returns 5 times oversampled true-peak from the set of samples.
+ */
+static float get_true_peak(const float prev[4], const float *samples, size_t nr_samples, float *sum_squares)
+{
+	/* These are normalized-sinc parameters for interpolating over sample
+	 * points which are located at x-coords: -1.5, -0.5, +0.5, +1.5.
+	 * And oversample points at x-coords: -0.3, -0.1, 0.1, 0.3. */
+	const __m128 m3 = _mm_set_ps(-0.155915f, 0.935489f, 0.233872f, -0.103943f);
+	const __m128 m1 = _mm_set_ps(-0.216236f, 0.756827f, 0.504551f, -0.189207f);
+	const __m128 p1 = _mm_set_ps(-0.189207f, 0.504551f, 0.756827f, -0.216236f);
+	const __m128 p3 = _mm_set_ps(-0.103943f, 0.233872f, 0.935489f, -0.155915f);
+
+	__m128 work = _mm_loadu_ps(prev);
+	__m128 peak = _mm_set1_ps(volmeter_prev_peak(prev));
+	__m128 sum = _mm_setzero_ps();
+	__m128 c = _mm_setzero_ps();
+	size_t i = 0;
+	for (; i < nr_samples && !IS_ALIGNED_PS(&samples[i]); i++)
+		TRUE_PEAK_SHIFT_IN_1(peak, sum, c, work, samples[i]);
+
+	for (; (i + 3) < nr_samples; i += 4) {
+		__m128 new_work = _mm_load_ps(&samples[i]);
+		__m128 intrp_samples;
+
+		/* Include the actual sample values in the peak. */
+		__m128 abs_new_work = abs_ps(new_work);
+		peak = _mm_max_ps(abs_new_work, peak);
+		KAHAN_ADD_PS(sum, c, _mm_mul_ps(new_work, new_work));
+
+		/* Shift in the next point. */
+		SHIFT_RIGHT_2PS(new_work, work);
+		VECTOR_MATRIX_CROSS_PS(intrp_samples, work, m3, m1, p1, p3);
+		peak = _mm_max_ps(abs_ps(intrp_samples), peak);
+
+		SHIFT_RIGHT_2PS(new_work, work);
+		VECTOR_MATRIX_CROSS_PS(intrp_samples, work, m3, m1, p1, p3);
+		peak = _mm_max_ps(abs_ps(intrp_samples), peak);
+
+		SHIFT_RIGHT_2PS(new_work, work);
+		VECTOR_MATRIX_CROSS_PS(intrp_samples, work, m3, m1, p1, p3);
+		peak = _mm_max_ps(abs_ps(intrp_samples), peak);
+
+		SHIFT_RIGHT_2PS(new_work, work);
+		VECTOR_MATRIX_CROSS_PS(intrp_samples, work, m3, m1, p1, p3);
+		peak = _mm_max_ps(abs_ps(intrp_samples), peak);
+	}
+
+	for (; i < nr_samples; i++)
+		TRUE_PEAK_SHIFT_IN_1(peak, sum, c, work, samples[i]);
+
+	*sum_squares = hsum_kahan_ps(sum, c);
+
+	float r;
+	hmax_ps(r, peak);
+	return r;
+}
+
+/* points contain the first four samples to calculate the sinc interpolation
+ * over. They will have come from a previous iteration.
+ * Same as get_true_peak, the samples don't need to be aligned and the sum of
+ * the squares is calculated together.
+ */
+static float get_sample_peak(const float prev[4], const float *samples, size_t nr_samples, float *sum_squares)
+{
+	__m128 peak = _mm_set1_ps(volmeter_prev_peak(prev));
+	__m128 sum = _mm_setzero_ps();
+	__m128 c = _mm_setzero_ps();
+	size_t i = 0;
+	for (; i < nr_samples && !IS_ALIGNED_PS(&samples[i]); i++)
+		SAMPLE_PEAK_1(peak, sum, c, samples[i]);
+
+	for (; (i + 3) < nr_samples; i += 4) {
+		__m128 new_work = _mm_load_ps(&samples[i]);
+		peak = _mm_max_ps(abs_ps(new_work), peak);
+		KAHAN_ADD_PS(sum, c, _mm_mul_ps(new_work, new_work));
+	}
+
+	for (; i < nr_samples; i++)
+		SAMPLE_PEAK_1(peak, sum, c, samples[i]);
+
+	*sum_squares = hsum_kahan_ps(sum, c);
+
+	float r;
+	hmax_ps(r, peak);
+	return r;
+}
+
+/* Polyphase FIR true peak of the 4 samples at `p`.
+ * `VOLMETER_FIR_TAPS - 1` samples before `p` have to be readable.
+ * Each window of 4 samples is loaded once and shared among the phases.
+ */
+static inline __m128 fir_true_peak_block(__m128 peak, const float *p, int nr_phases,
+					 const __m128 c[VOLMETER_FIR_MAX_PHASES][VOLMETER_FIR_TAPS], __m128 *sum,
+					 __m128 *comp)
+{
+	__m128 x[VOLMETER_FIR_TAPS];
+	for (int k = 0; k < VOLMETER_FIR_TAPS; k++)
+		x[k] = _mm_loadu_ps(p - (VOLMETER_FIR_TAPS - 1) + k);
+
+	__m128 s = x[VOLMETER_FIR_TAPS - 1];
+	peak = _mm_max_ps(abs_ps(s), peak);
+	KAHAN_ADD_PS(*sum, *comp, _mm_mul_ps(s, s));
+
+	for (int ph = 0; ph < nr_phases; ph++) {
+		__m128 y = _mm_mul_ps(x[0], c[ph][0]);
+		for (int k = 1; k < VOLMETER_FIR_TAPS; k++)
+			y = _mm_add_ps(y, _mm_mul_ps(x[k], c[ph][k]));
+		peak = _mm_max_ps(abs_ps(y), peak);
+	}
+
+	return peak;
+}
+
+/* Calculate the true peak by the polyphase FIR filter.
+ * The first `VOLMETER_FIR_TAPS - 1` samples need the previous samples and
+ * the last samples not filling 4 are processed by the scalar code.
+ */
+static float get_fir_true_peak(const struct volmeter_fir_s *fir, const float prev[VOLMETER_HISTORY],
+			       const float *samples, size_t nr_samples, float *sum_squares)
+{
+	__m128 c[VOLMETER_FIR_MAX_PHASES][VOLMETER_FIR_TAPS];
+	for (int ph = 0; ph < fir->nr_phases; ph++) {
+		for (int k = 0; k < VOLMETER_FIR_TAPS; k++)
+			c[ph][k] = _mm_set1_ps(fir->coefs[ph][k]);
+	}
+
+	double sum_d = 0.0;
+	size_t i = nr_samples < VOLMETER_HISTORY ? nr_samples : VOLMETER_HISTORY;
+	float r = volmeter_fir_true_peak_scalar(0.0f, fir, prev, samples, 0, i, &sum_d);
+
+	__m128 peak = _mm_setzero_ps();
+	__m128 sum = _mm_setzero_ps();
+	__m128 comp = _mm_setzero_ps();
+	for (; i + 4 <= nr_samples; i += 4)
+		peak = fir_true_peak_block(peak, samples + i, fir->nr_phases, c, &sum, &comp);
+
+	sum_d += hsum_kahan_ps(sum, comp);
+
+	float peak_s;
+	hmax_ps(peak_s, peak);
+	r = volmeter_fir_true_peak_scalar(fmaxf(r, peak_s), fir, prev, samples, i, nr_samples, &sum_d);
+	*sum_squares = (float)sum_d;
+	return r;
+}
+
+const struct volmeter_kernel_s volmeter_kernel_sse = {
+	.name = "SSE",
+	.sample_peak = get_sample_peak,
+	.true_peak = get_true_peak,
+	.fir_true_peak = get_fir_true_peak,
+};
+
+#endif // VOLMETER_KERNEL_X86
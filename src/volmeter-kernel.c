@@ -0,0 +1,178 @@
+/*
+Graphical Volume Meter Plugin for OBS Studio
+Copyright (C) 2026 Norihiro Kamae <norihiro@nagater.net>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "plugin-macros.generated.h"
+#include "volmeter-kernel.h"
+
+const struct volmeter_fir_s volmeter_fir_4x = {
+	.nr_phases = 4,
+	.coefs =
+		{
+			{0.0017089843750f, 0.0109863281250f, -0.0196533203125f, 0.0332031250000f, -0.0594482421875f,
+			 0.1373291015625f, 0.9721679687500f, -0.1022949218750f, 0.0476074218750f, -0.0266113281250f,
+			 0.0148925781250f, -0.0083007812500f},
+			{-0.0291748046875f, 0.0292968750000f, -0.0517578125000f, 0.0891113281250f, -0.1665039062500f,
+			 0.4650878906250f, 0.7797851562500f, -0.2003173828125f, 0.1015625000000f, -0.0582275390625f,
+			 0.0330810546875f, -0.0189208984375f},
+			{-0.0189208984375f, 0.0330810546875f, -0.0582275390625f, 0.1015625000000f, -0.2003173828125f,
+			 0.7797851562500f, 0.4650878906250f, -0.1665039062500f, 0.0891113281250f, -0.0517578125000f,
+			 0.0292968750000f, -0.0291748046875f},
+			{-0.0083007812500f, 0.0148925781250f, -0.0266113281250f, 0.0476074218750f, -0.1022949218750f,
+			 0.9721679687500f, 0.1373291015625f, -0.0594482421875f, 0.0332031250000f, -0.0196533203125f,
+			 0.0109863281250f, 0.0017089843750f},
+		},
+};
+
+/* Phase `m` is located at `(2m + 1) / 16` before the 7th tap.
+ * Coefficients are `sinc(d) * kaiser(d / 7, beta = 3.5)`, where `d` is the
+ * distance from the tap. */
+const struct volmeter_fir_s volmeter_fir_8x = {
+	.nr_phases = 8,
+	.coefs =
+		{
+			{-0.0029233f, 0.0055270f, -0.0095770f, 0.0161571f, -0.0285834f, 0.0645072f, 0.9934703f,
+			 -0.0564888f, 0.0264374f, -0.0151248f, 0.0089647f, -0.0051357f},
+			{-0.0090816f, 0.0169168f, -0.0291233f, 0.0491831f, -0.0882827f, 0.2133686f, 0.9421697f,
+			 -0.1427098f, 0.0698189f, -0.0403388f, 0.0238840f, -0.0135697f},
+			{-0.0147901f, 0.0271786f, -0.0465284f, 0.0787470f, -0.1438368f, 0.3795298f, 0.8444462f,
+			 -0.1914109f, 0.0971163f, -0.0565585f, 0.0334199f, -0.0188130f},
+			{-0.0189411f, 0.0343785f, -0.0585767f, 0.0994768f, -0.1855397f, 0.5497541f, 0.7094912f,
+			 -0.2040007f, 0.1066684f, -0.0625125f, 0.0368296f, -0.0205215f},
+			{-0.0205215f, 0.0368296f, -0.0625125f, 0.1066684f, -0.2040007f, 0.7094912f, 0.5497541f,
+			 -0.1855397f, 0.0994768f, -0.0585767f, 0.0343785f, -0.0189411f},
+			{-0.0188130f, 0.0334199f, -0.0565585f, 0.0971163f, -0.1914109f, 0.8444462f, 0.3795298f,
+			 -0.1438368f, 0.0787470f, -0.0465284f, 0.0271786f, -0.0147901f},
+			{-0.0135697f, 0.0238840f, -0.0403388f, 0.0698189f, -0.1427098f, 0.9421697f, 0.2133686f,
+			 -0.0882827f, 0.0491831f, -0.0291233f, 0.0169168f, -0.0090816f},
+			{-0.0051357f, 0.0089647f, -0.0151248f, 0.0264374f, -0.0564888f, 0.9934703f, 0.0645072f,
+			 -0.0285834f, 0.0161571f, -0.0095770f, 0.0055270f, -0.0029233f},
+		},
+};
+
+#ifdef VOLMETER_KERNEL_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+
+static bool cpu_supports_xsave_state(uint64_t mask)
+{
+	int info[4];
+	__cpuid(info, 1);
+	const int osxsave = 1 << 27;
+	const int avx = 1 << 28;
+	if ((info[2] & (osxsave | avx)) != (osxsave | avx))
+		return false;
+	return (_xgetbv(0) & mask) == mask;
+}
+
+static bool cpu_supports_leaf7_ebx(int bit)
+{
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << bit)) != 0;
+}
+
+static bool cpu_supports_avx2(void)
+{
+	/* XMM and YMM states */
+	return cpu_supports_xsave_state(0x6) && cpu_supports_leaf7_ebx(5);
+}
+
+static bool cpu_supports_avx512(void)
+{
+	/* XMM, YMM, opmask, and upper ZMM states */
+	return cpu_supports_xsave_state(0xe6) && cpu_supports_leaf7_ebx(16);
+}
+#else
+static bool cpu_supports_avx2(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+}
+
+static bool cpu_supports_avx512(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx512f");
+}
+#endif
+#endif // VOLMETER_KERNEL_X86
+
+static inline bool kernel_requested(const char *id)
+{
+	return strcmp(VOLMETER_KERNEL, "auto") == 0 || strcmp(VOLMETER_KERNEL, id) == 0;
+}
+
+size_t volmeter_kernel_get_supported(const struct volmeter_kernel_s **kernels, const char **ids, size_t size)
+{
+	size_t n = 0;
+#define ADD_KERNEL(kernel, id)               \
+	do {                                 \
+		if (n < size) {              \
+			kernels[n] = kernel; \
+			if (ids)             \
+				ids[n] = id; \
+		}                            \
+		n++;                         \
+	} while (0)
+
+#ifdef VOLMETER_KERNEL_X86
+	if (cpu_supports_avx512())
+		ADD_KERNEL(&volmeter_kernel_avx512, "avx512");
+	if (cpu_supports_avx2())
+		ADD_KERNEL(&volmeter_kernel_avx2, "avx2");
+	ADD_KERNEL(&volmeter_kernel_sse, "sse");
+#endif
+#ifdef VOLMETER_KERNEL_NEON
+	ADD_KERNEL(&volmeter_kernel_neon, "neon");
+#endif
+	ADD_KERNEL(&volmeter_kernel_c, "c");
+
+#undef ADD_KERNEL
+	return n;
+}
+
+static const struct volmeter_kernel_s *select_kernel(void)
+{
+	const struct volmeter_kernel_s *kernels[VOLMETER_KERNEL_MAX];
+	const char *ids[VOLMETER_KERNEL_MAX];
+	size_t n = volmeter_kernel_get_supported(kernels, ids, VOLMETER_KERNEL_MAX);
+
+	for (size_t i = 0; i < n && i < VOLMETER_KERNEL_MAX; i++) {
+		if (kernel_requested(ids[i]))
+			return kernels[i];
+	}
+	return &volmeter_kernel_c;
+}
+
+const struct volmeter_kernel_s *volmeter_kernel_get(void)
+{
+	/* The selection always results in the same value so that a race
+	 * between threads is harmless. */
+	static const struct volmeter_kernel_s *kernel = NULL;
+	if (!kernel)
+		kernel = select_kernel();
+	return kernel;
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <stddef.h>
+#include <math.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Number of the taps of each phase of the polyphase FIR true-peak filters. */
+#define VOLMETER_FIR_TAPS 12
+#define VOLMETER_FIR_MAX_PHASES 8
+
+/* Number of the samples of the previous call needed by the kernels. */
+#define VOLMETER_HISTORY (VOLMETER_FIR_TAPS - 1)
+
+/* Polyphase FIR filter to interpolate `nr_phases` points per sample.
+ * Phase `p` of the output at sample `i` is
+ * `sum(coefs[p][k] * x[i - (VOLMETER_FIR_TAPS - 1) + k])`, located between
+ * `x[i - 6]` and `x[i - 5]`. */
+struct volmeter_fir_s
+{
+	int nr_phases;
+	float coefs[VOLMETER_FIR_MAX_PHASES][VOLMETER_FIR_TAPS];
+};
+
+/* 4x oversampling, 48 taps, from ITU-R BS.1770-4 Annex 2. */
+extern const struct volmeter_fir_s volmeter_fir_4x;
+
+/* 8x oversampling, 96 taps, Kaiser-windowed sinc with the parameters fitted to
+ * the 4x filter. */
+extern const struct volmeter_fir_s volmeter_fir_8x;
+
+/* Set of functions to calculate the peak and the sum of the squares of one
+ * audio plane in a single pass.
+ *
+ * `previous_samples` are the last samples of the previous call, the last
+ * element is the newest one. `sample_peak` and `true_peak` take 4 samples,
+ * `fir_true_peak` takes `VOLMETER_HISTORY` samples. The functions don't
+ * update them.
+ * `samples` don't need to be aligned.
+ * The sum of the squares is accumulated by the compensated summation or in
+ * double precision.
+ */
+struct volmeter_kernel_s
+{
+	const char *name;
+	float (*sample_peak)(const float previous_samples[4], const float *samples, size_t nr_samples,
+			     float *sum_squares);
+	float (*true_peak)(const float previous_samples[4], const float *samples, size_t nr_samples,
+			   float *sum_squares);
+	float (*fir_true_peak)(const struct volmeter_fir_s *fir, const float previous_samples[VOLMETER_HISTORY],
+			       const float *samples, size_t nr_samples, float *sum_squares);
+};
+
+/* Plain-C implementation, available on all architectures.
+ * This is also the reference of the other kernels. */
+extern const struct volmeter_kernel_s volmeter_kernel_c;
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define VOLMETER_KERNEL_X86
+extern const struct volmeter_kernel_s volmeter_kernel_sse;
+extern const struct volmeter_kernel_s volmeter_kernel_avx2;
+extern const struct volmeter_kernel_s volmeter_kernel_avx512;
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define VOLMETER_KERNEL_NEON
+extern const struct volmeter_kernel_s volmeter_kernel_neon;
+#endif
+
+/* Maximum number of the kernels returned by volmeter_kernel_get_supported. */
+#define VOLMETER_KERNEL_MAX 4
+
+/* Lists the kernels supported by the running CPU, fastest first, together
+ * with their IDs used by the CMake option VOLMETER_KERNEL.
+ * `ids` can be NULL. Returns the number of the supported kernels. */
+size_t volmeter_kernel_get_supported(const struct volmeter_kernel_s **kernels, const char **ids, size_t size);
+
+/* Returns the fastest kernel supported by the running CPU.
+ * If the CMake option VOLMETER_KERNEL is not `auto`, returns that kernel if
+ * supported, otherwise the plain-C kernel. */
+const struct volmeter_kernel_s *volmeter_kernel_get(void);
+
+/* Normalized-sinc parameters for interpolating over sample points which are
+ * located at x-coords: -1.5, -0.5, +0.5, +1.5.
+ * And oversample points at x-coords: -0.3, -0.1, 0.1, 0.3.
+ * Each row is multiplied with the 4 samples ordered from the oldest one. */
+static const float volmeter_true_peak_coefs[4][4] = {
+	{-0.103943f, 0.233872f, 0.935489f, -0.155915f},
+	{-0.189207f, 0.504551f, 0.756827f, -0.216236f},
+	{-0.216236f, 0.756827f, 0.504551f, -0.189207f},
+	{-0.155915f, 0.935489f, 0.233872f, -0.103943f},
+};
+
+/* All kernels start the peak with the previous samples without taking the
+ * absolute value, same as the original SSE implementation.
+ * NaN is ignored by all kernels, so the start is never NaN. */
+static inline float volmeter_prev_peak(const float prev[4])
+{
+	float peak = fmaxf(fmaxf(prev[0], prev[1]), fmaxf(prev[2], prev[3]));
+	return isnan(peak) ? -INFINITY : peak;
+}
+
+/* Scalar true peak of the samples from `i` to `end`. Used by the plain-C
+ * kernel and for the remaining samples of the SIMD kernels.
+ *
+ * The interpolated point is summed up in the same order as the SSE kernel,
+ * (((x0 * c0) + (x1 * c1)) + (x2 * c2)) + (x3 * c3), so that the results
+ * are bit-exact. The kernels have to be compiled without contracting into
+ * FMA. */
+static inline float volmeter_true_peak_scalar(float peak, const float prev[4], const float *samples, size_t i,
+					      size_t end, double *sum_squares)
+{
+	for (; i < end; i++) {
+		float x[4];
+		for (int k = 0; k < 4; k++) {
+			ptrdiff_t j = (ptrdiff_t)i + k - 3;
+			x[k] = j < 0 ? prev[4 + j] : samples[j];
+		}
+
+		peak = fmaxf(peak, fabsf(x[3]));
+		*sum_squares += x[3] * x[3];
+		for (int k = 0; k < 4; k++) {
+			const float *c = volmeter_true_peak_coefs[k];
+			float y = x[0] * c[0];
+			y += x[1] * c[1];
+			y += x[2] * c[2];
+			y += x[3] * c[3];
+			peak = fmaxf(peak, fabsf(y));
+		}
+	}
+	return peak;
+}
+
+static inline float volmeter_sample_peak_scalar(float peak, const float *samples, size_t i, size_t end,
+						double *sum_squares)
+{
+	for (; i < end; i++) {
+		peak = fmaxf(peak, fabsf(samples[i]));
+		*sum_squares += samples[i] * samples[i];
+	}
+	return peak;
+}
+
+/* Scalar polyphase FIR true peak of the samples from `i` to `end`.
+ * Each phase is summed up from the oldest tap so that the SIMD kernels can
+ * be bit-exact. Unlike the 4-point true peak, the peak doesn't start with
+ * the previous samples since they were already measured by the last call. */
+static inline float volmeter_fir_true_peak_scalar(float peak, const struct volmeter_fir_s *fir,
+						  const float prev[VOLMETER_HISTORY], const float *samples, size_t i,
+						  size_t end, double *sum_squares)
+{
+	for (; i < end; i++) {
+		float x[VOLMETER_FIR_TAPS];
+		for (int k = 0; k < VOLMETER_FIR_TAPS; k++) {
+			ptrdiff_t j = (ptrdiff_t)i + k - (VOLMETER_FIR_TAPS - 1);
+			x[k] = j < 0 ? prev[VOLMETER_HISTORY + j] : samples[j];
+		}
+
+		const float sample = x[VOLMETER_FIR_TAPS - 1];
+		peak = fmaxf(peak, fabsf(sample));
+		*sum_squares += sample * sample;
+		for (int p = 0; p < fir->nr_phases; p++) {
+			const float *c = fir->coefs[p];
+			float y = x[0] * c[0];
+			for (int k = 1; k < VOLMETER_FIR_TAPS; k++)
+				y += x[k] * c[k];
+			peak = fmaxf(peak, fabsf(y));
+		}
+	}
+	return peak;
+}
+
+#ifdef __cplusplus
+}
+#endif
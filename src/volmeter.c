@@ -19,17 +19,17 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <math.h>
-
-#include <util/sse-intrin.h>
+#include <string.h>
 
 #include <util/threading.h>
+#include <util/platform.h>
 #include <util/bmem.h>
-#include <media-io/audio-math.h>
 #include <obs.h>
 
 #include <obs-audio-controls.h>
 #include "plugin-macros.generated.h"
 #include "volmeter.h"
+#include "volmeter-kernel.h"
 
 static inline bool obs_object_valid(const void *obj, const char *f, const char *t)
 {
@@ -51,34 +51,141 @@ static inline bool obs_object_valid(const void *obj, const char *f, const char *
 
 struct meter_cb
 {
-	obs_volmeter_updated_t callback;
+	volmeter_updated_t callback;
 	void *param;
 };
 
+/* Immutable list of the callbacks. The volmeter holds a reference while it
+ * is the current list, and the audio thread holds one while calling it. */
+struct meter_cb_list
+{
+	volatile long refs;
+	size_t num;
+	struct meter_cb *array;
+};
+
 struct volmeter_s
 {
 	pthread_mutex_t mutex;
 
+	/* Adding or removing a callback, serialized by `callback_mutex`,
+	 * creates a new list and switches `callbacks` to it under `mutex`,
+	 * which the audio thread holds anyway to take a reference.
+	 * The replaced list is freed by its last holder, usually the audio
+	 * thread after calling it, without waiting in the writer.
+	 * `nr_retired` counts the replaced lists not freed yet and
+	 * `retired_event` is signaled when it becomes 0. */
 	pthread_mutex_t callback_mutex;
-	DARRAY(struct meter_cb) callbacks;
+	struct meter_cb_list *callbacks;
+	volatile long nr_retired;
+	os_event_t *retired_event;
 
-	enum obs_peak_meter_type peak_meter_type;
+	const struct volmeter_kernel_s *kernel;
+
+	enum volmeter_peak_type peak_meter_type;
+
+	/* The levels are published once per `update_frames` on average, 0 to
+	 * publish every packet. The peak of every packet in between is taken
+	 * by `peak_meter_type` and accumulated until published. */
 	unsigned int update_ms;
-	float prev_samples[MAX_AUDIO_CHANNELS][4];
+	int64_t update_frames;
+	int64_t frames_to_publish;
+
+	// protected by `mutex`, accumulated since the last publish
+	uint32_t pending_nr_channels;
+	uint32_t pending_frames;
+	float pending_sum_squares[MAX_AUDIO_CHANNELS];
+	float pending_peak[MAX_AUDIO_CHANNELS];
+
+	// number of the channels of the last audio data, 0 until the first one
+	volatile long nr_channels;
 
-	float magnitude[MAX_AUDIO_CHANNELS];
-	float peak[MAX_AUDIO_CHANNELS];
+	/* Last samples of each channel, carried to the next packet as the
+	 * state of the true-peak filters. */
+	float prev_samples[MAX_AUDIO_CHANNELS][VOLMETER_HISTORY];
+
+	// EBU R128 loudness, NULL if disabled
+	loudness_t *loudness;
+
+	struct latency_stats_s latency[VOLMETER_NR_STAGES];
 };
 
-static void signal_levels_updated(volmeter_t *volmeter, const float magnitude[MAX_AUDIO_CHANNELS],
-				  const float peak[MAX_AUDIO_CHANNELS], const float input_peak[MAX_AUDIO_CHANNELS])
+static void signal_levels_updated(const struct meter_cb_list *callbacks, const struct volmeter_levels_s *levels)
 {
-	pthread_mutex_lock(&volmeter->callback_mutex);
-	for (size_t i = volmeter->callbacks.num; i > 0; i--) {
-		struct meter_cb cb = volmeter->callbacks.array[i - 1];
-		cb.callback(cb.param, magnitude, peak, input_peak);
+	for (size_t i = callbacks->num; i > 0; i--) {
+		const struct meter_cb *cb = &callbacks->array[i - 1];
+		cb->callback(cb->param, levels);
 	}
-	pthread_mutex_unlock(&volmeter->callback_mutex);
+}
+
+/* Need to hold `mutex`. */
+static struct meter_cb_list *callbacks_acquire(volmeter_t *volmeter)
+{
+	struct meter_cb_list *callbacks = volmeter->callbacks;
+	if (callbacks)
+		os_atomic_inc_long(&callbacks->refs);
+	return callbacks;
+}
+
+static void callbacks_release(volmeter_t *volmeter, struct meter_cb_list *callbacks)
+{
+	if (!callbacks || os_atomic_dec_long(&callbacks->refs) > 0)
+		return;
+
+	/* Only a replaced list comes here. */
+	bfree(callbacks);
+	if (os_atomic_dec_long(&volmeter->nr_retired) == 0)
+		os_event_signal(volmeter->retired_event);
+}
+
+/* Returns a new list copied from `cur` with `cb` added, or with the first one
+ * same as `cb` removed. */
+static struct meter_cb_list *callbacks_create(const struct meter_cb_list *cur, const struct meter_cb *cb, bool add)
+{
+	size_t num = cur ? cur->num : 0;
+	struct meter_cb_list *callbacks = bmalloc(sizeof(struct meter_cb_list) + sizeof(struct meter_cb) * (num + 1));
+	callbacks->refs = 1;
+	callbacks->num = 0;
+	callbacks->array = (struct meter_cb *)(callbacks + 1);
+
+	bool removed = add;
+	for (size_t i = 0; i < num; i++) {
+		const struct meter_cb *c = &cur->array[i];
+		if (!removed && c->callback == cb->callback && c->param == cb->param) {
+			removed = true;
+			continue;
+		}
+		callbacks->array[callbacks->num++] = *c;
+	}
+
+	if (add)
+		callbacks->array[callbacks->num++] = *cb;
+
+	return callbacks;
+}
+
+/* Switches to the new list and retires the current one.
+ * Need to hold `callback_mutex`. */
+static void callbacks_replace(volmeter_t *volmeter, struct meter_cb_list *callbacks)
+{
+	pthread_mutex_lock(&volmeter->mutex);
+	struct meter_cb_list *prev = volmeter->callbacks;
+	volmeter->callbacks = callbacks;
+	pthread_mutex_unlock(&volmeter->mutex);
+
+	if (prev) {
+		os_atomic_inc_long(&volmeter->nr_retired);
+		callbacks_release(volmeter, prev);
+	}
+}
+
+/* Waits until the audio thread has left the replaced lists. It holds a list
+ * only while calling the callbacks, so it is usually not waited at all.
+ * Need to hold `callback_mutex` so that no more list is retired. */
+static void callbacks_wait_retired(volmeter_t *volmeter)
+{
+	while (os_atomic_load_long(&volmeter->nr_retired) > 0)
+		os_event_wait(volmeter->retired_event);
 }
 
 static int get_nr_channels_from_audio_data(const struct audio_data *data)
@@ -93,246 +200,182 @@ static int get_nr_channels_from_audio_data(const struct audio_data *data)
 	return nr_channels;
 }
 
-/* msb(h, g, f, e) lsb(d, c, b, a)   -->  msb(h, h, g, f) lsb(e, d, c, b)
- */
-#define SHIFT_RIGHT_2PS(msb, lsb)                                               \
-	{                                                                       \
-		__m128 tmp = _mm_shuffle_ps(lsb, msb, _MM_SHUFFLE(0, 0, 3, 3)); \
-		lsb = _mm_shuffle_ps(lsb, tmp, _MM_SHUFFLE(2, 1, 2, 1));        \
-		msb = _mm_shuffle_ps(msb, msb, _MM_SHUFFLE(3, 3, 2, 1));        \
-	}
+static void volmeter_process_peak_last_samples(volmeter_t *volmeter, int channel_nr, float *samples, size_t nr_samples)
+{
+	/* Take the last samples that need to be used for the next peak
+	 * calculation. If there are less samples than that in total the new
+	 * samples shift out the old samples. */
+	float *prev = volmeter->prev_samples[channel_nr];
 
-/* x(d, c, b, a) --> (|d|, |c|, |b|, |a|)
- */
-#define abs_ps(v) _mm_andnot_ps(_mm_set1_ps(-0.f), v)
-
-/* Take cross product of a vector with a matrix resulting in vector.
- */
-#define VECTOR_MATRIX_CROSS_PS(out, v, m0, m1, m2, m3)    \
-	{                                                 \
-		out = _mm_mul_ps(v, m0);                  \
-		__m128 mul1 = _mm_mul_ps(v, m1);          \
-		__m128 mul2 = _mm_mul_ps(v, m2);          \
-		__m128 mul3 = _mm_mul_ps(v, m3);          \
-                                                          \
-		_MM_TRANSPOSE4_PS(out, mul1, mul2, mul3); \
-                                                          \
-		out = _mm_add_ps(out, mul1);              \
-		out = _mm_add_ps(out, mul2);              \
-		out = _mm_add_ps(out, mul3);              \
+	if (nr_samples >= VOLMETER_HISTORY) {
+		memcpy(prev, samples + nr_samples - VOLMETER_HISTORY, sizeof(float) * VOLMETER_HISTORY);
 	}
-
-/* x4(d, c, b, a)  -->  max(a, b, c, d)
- */
-#define hmax_ps(r, x4)                     \
-	do {                               \
-		float x4_mem[4];           \
-		_mm_storeu_ps(x4_mem, x4); \
-		r = x4_mem[0];             \
-		r = fmaxf(r, x4_mem[1]);   \
-		r = fmaxf(r, x4_mem[2]);   \
-		r = fmaxf(r, x4_mem[3]);   \
-	} while (false)
-
-/* Calculate the true peak over a set of samples.
- * The algorithm implements 5x oversampling by using Whittaker-Shannon
- * interpolation over four samples.
- *
- * The four samples have location t=-1.5, -0.5, +0.5, +1.5
- * The oversamples are taken at locations t=-0.3, -0.1, +0.1, +0.3
- *
- * @param previous_samples  Last 4 samples from the previous iteration.
- * @param samples           The samples to find the peak in.
- * @param nr_samples        Number of sets of 4 samples.
- * @returns 5 times oversampled true-peak from the set of samples.
- */
-static float get_true_peak(__m128 previous_samples, const float *samples, size_t nr_samples)
-{
-	/* These are normalized-sinc parameters for interpolating over sample
-	 * points which are located at x-coords: -1.5, -0.5, +0.5, +1.5.
-	 * And oversample points at x-coords: -0.3, -0.1, 0.1, 0.3. */
-	const __m128 m3 = _mm_set_ps(-0.155915f, 0.935489f, 0.233872f, -0.103943f);
-	const __m128 m1 = _mm_set_ps(-0.216236f, 0.756827f, 0.504551f, -0.189207f);
-	const __m128 p1 = _mm_set_ps(-0.189207f, 0.504551f, 0.756827f, -0.216236f);
-	const __m128 p3 = _mm_set_ps(-0.103943f, 0.233872f, 0.935489f, -0.155915f);
-
-	__m128 work = previous_samples;
-	__m128 peak = previous_samples;
-	for (size_t i = 0; (i + 3) < nr_samples; i += 4) {
-		__m128 new_work = _mm_load_ps(&samples[i]);
-		__m128 intrp_samples;
-
-		/* Include the actual sample values in the peak. */
-		__m128 abs_new_work = abs_ps(new_work);
-		peak = _mm_max_ps(peak, abs_new_work);
-
-		/* Shift in the next point. */
-		SHIFT_RIGHT_2PS(new_work, work);
-		VECTOR_MATRIX_CROSS_PS(intrp_samples, work, m3, m1, p1, p3);
-		peak = _mm_max_ps(peak, abs_ps(intrp_samples));
-
-		SHIFT_RIGHT_2PS(new_work, work);
-		VECTOR_MATRIX_CROSS_PS(intrp_samples, work, m3, m1, p1, p3);
-		peak = _mm_max_ps(peak, abs_ps(intrp_samples));
-
-		SHIFT_RIGHT_2PS(new_work, work);
-		VECTOR_MATRIX_CROSS_PS(intrp_samples, work, m3, m1, p1, p3);
-		peak = _mm_max_ps(peak, abs_ps(intrp_samples));
-
-		SHIFT_RIGHT_2PS(new_work, work);
-		VECTOR_MATRIX_CROSS_PS(intrp_samples, work, m3, m1, p1, p3);
-		peak = _mm_max_ps(peak, abs_ps(intrp_samples));
+	else if (nr_samples > 0) {
+		memmove(prev, prev + nr_samples, sizeof(float) * (VOLMETER_HISTORY - nr_samples));
+		memcpy(prev + VOLMETER_HISTORY - nr_samples, samples, sizeof(float) * nr_samples);
 	}
-
-	float r;
-	hmax_ps(r, peak);
-	return r;
 }
 
-/* points contain the first four samples to calculate the sinc interpolation
- * over. They will have come from a previous iteration.
- */
-static float get_sample_peak(__m128 previous_samples, const float *samples, size_t nr_samples)
+static void volmeter_reset_pending(volmeter_t *volmeter, uint32_t nr_channels)
 {
-	__m128 peak = previous_samples;
-	for (size_t i = 0; (i + 3) < nr_samples; i += 4) {
-		__m128 new_work = _mm_load_ps(&samples[i]);
-		peak = _mm_max_ps(peak, abs_ps(new_work));
+	volmeter->pending_nr_channels = nr_channels;
+	volmeter->pending_frames = 0;
+	for (uint32_t ch = 0; ch < nr_channels; ch++) {
+		volmeter->pending_sum_squares[ch] = 0.0f;
+		volmeter->pending_peak[ch] = 0.0f;
 	}
-
-	float r;
-	hmax_ps(r, peak);
-	return r;
 }
 
-static void volmeter_process_peak_last_samples(volmeter_t *volmeter, int channel_nr, float *samples, size_t nr_samples)
+static bool volmeter_need_publish(volmeter_t *volmeter, size_t nr_samples)
 {
-	/* Take the last 4 samples that need to be used for the next peak
-	 * calculation. If there are less than 4 samples in total the new
-	 * samples shift out the old samples. */
+	if (!volmeter->update_frames)
+		return true;
 
-	switch (nr_samples) {
-	case 0:
-		break;
-	case 1:
-		volmeter->prev_samples[channel_nr][0] = volmeter->prev_samples[channel_nr][1];
-		volmeter->prev_samples[channel_nr][1] = volmeter->prev_samples[channel_nr][2];
-		volmeter->prev_samples[channel_nr][2] = volmeter->prev_samples[channel_nr][3];
-		volmeter->prev_samples[channel_nr][3] = samples[nr_samples - 1];
-		break;
-	case 2:
-		volmeter->prev_samples[channel_nr][0] = volmeter->prev_samples[channel_nr][2];
-		volmeter->prev_samples[channel_nr][1] = volmeter->prev_samples[channel_nr][3];
-		volmeter->prev_samples[channel_nr][2] = samples[nr_samples - 2];
-		volmeter->prev_samples[channel_nr][3] = samples[nr_samples - 1];
-		break;
-	case 3:
-		volmeter->prev_samples[channel_nr][0] = volmeter->prev_samples[channel_nr][3];
-		volmeter->prev_samples[channel_nr][1] = samples[nr_samples - 3];
-		volmeter->prev_samples[channel_nr][2] = samples[nr_samples - 2];
-		volmeter->prev_samples[channel_nr][3] = samples[nr_samples - 1];
-		break;
-	default:
-		volmeter->prev_samples[channel_nr][0] = samples[nr_samples - 4];
-		volmeter->prev_samples[channel_nr][1] = samples[nr_samples - 3];
-		volmeter->prev_samples[channel_nr][2] = samples[nr_samples - 2];
-		volmeter->prev_samples[channel_nr][3] = samples[nr_samples - 1];
-	}
+	/* Carry the remainder so that the average rate follows `update_ms`
+	 * even if it is not a multiple of the packet. */
+	volmeter->frames_to_publish -= (int64_t)nr_samples;
+	if (volmeter->frames_to_publish > 0)
+		return false;
+
+	volmeter->frames_to_publish += volmeter->update_frames;
+	if (volmeter->frames_to_publish <= 0)
+		volmeter->frames_to_publish = volmeter->update_frames;
+	return true;
 }
 
-static void volmeter_process_peak(volmeter_t *volmeter, const struct audio_data *data, int nr_channels)
+/* Returns true if `levels` is filled and has to be published. */
+static bool volmeter_process_audio_data(volmeter_t *volmeter, const struct audio_data *data,
+					struct volmeter_levels_s *levels)
 {
-	int nr_samples = data->frames;
+	int nr_channels = get_nr_channels_from_audio_data(data);
+	size_t nr_samples = data->frames;
+
+	if (os_atomic_load_long(&volmeter->nr_channels) != nr_channels)
+		os_atomic_set_long(&volmeter->nr_channels, nr_channels);
+
+	if (volmeter->pending_nr_channels != (uint32_t)nr_channels)
+		volmeter_reset_pending(volmeter, (uint32_t)nr_channels);
+
+	bool publish = volmeter_need_publish(volmeter, nr_samples);
+
+	const float *planes[MAX_AUDIO_CHANNELS];
+
 	int channel_nr = 0;
 	for (int plane_nr = 0; channel_nr < nr_channels; plane_nr++) {
 		float *samples = (float *)data->data[plane_nr];
 		if (!samples) {
 			continue;
 		}
-		if (((uintptr_t)samples & 0xf) > 0) {
-			blog(LOG_WARNING, "Audio plane %i is not aligned %p skipping peak volume measurement.",
-			     plane_nr, samples);
-			volmeter->peak[channel_nr] = 1.0;
-			channel_nr++;
-			continue;
-		}
 
-		/* volmeter->prev_samples may not be aligned to 16 bytes;
-		 * use unaligned load. */
-		__m128 previous_samples = _mm_loadu_ps(volmeter->prev_samples[channel_nr]);
+		const float *previous_samples = volmeter->prev_samples[channel_nr];
+		const float *previous_4_samples = previous_samples + VOLMETER_HISTORY - 4;
 
+		/* The peak and the magnitude are calculated in one pass. */
 		float peak;
+		float sum_squares;
 		switch (volmeter->peak_meter_type) {
-		case TRUE_PEAK_METER:
-			peak = get_true_peak(previous_samples, samples, nr_samples);
+		case VOLMETER_TRUE_PEAK:
+			peak = volmeter->kernel->true_peak(previous_4_samples, samples, nr_samples, &sum_squares);
+			break;
+
+		case VOLMETER_TRUE_PEAK_FIR4:
+			peak = volmeter->kernel->fir_true_peak(&volmeter_fir_4x, previous_samples, samples, nr_samples,
+							       &sum_squares);
+			break;
+
+		case VOLMETER_TRUE_PEAK_FIR8:
+			peak = volmeter->kernel->fir_true_peak(&volmeter_fir_8x, previous_samples, samples, nr_samples,
+							       &sum_squares);
 			break;
 
-		case SAMPLE_PEAK_METER:
+		case VOLMETER_SAMPLE_PEAK:
 		default:
-			peak = get_sample_peak(previous_samples, samples, nr_samples);
+			peak = volmeter->kernel->sample_peak(previous_4_samples, samples, nr_samples, &sum_squares);
 			break;
 		}
 
 		volmeter_process_peak_last_samples(volmeter, channel_nr, samples, nr_samples);
 
-		volmeter->peak[channel_nr] = peak;
+		volmeter->pending_peak[channel_nr] = fmaxf(volmeter->pending_peak[channel_nr], peak);
+		volmeter->pending_sum_squares[channel_nr] += sum_squares;
 
+		planes[channel_nr] = samples;
 		channel_nr++;
 	}
+	volmeter->pending_frames += (uint32_t)nr_samples;
 
-	/* Clear the peak of the channels that have not been handled. */
-	for (; channel_nr < MAX_AUDIO_CHANNELS; channel_nr++) {
-		volmeter->peak[channel_nr] = 0.0;
-	}
-}
-
-static void volmeter_process_magnitude(volmeter_t *volmeter, const struct audio_data *data, int nr_channels)
-{
-	size_t nr_samples = data->frames;
-
-	int channel_nr = 0;
-	for (int plane_nr = 0; channel_nr < nr_channels; plane_nr++) {
-		float *samples = (float *)data->data[plane_nr];
-		if (!samples) {
-			continue;
-		}
+	// The filters of the loudness need every packet.
+	if (volmeter->loudness)
+		loudness_process(volmeter->loudness, planes, (uint32_t)nr_channels, nr_samples);
 
-		float sum = 0.0;
-		for (size_t i = 0; i < nr_samples; i++) {
-			float sample = samples[i];
-			sum += sample * sample;
-		}
-		volmeter->magnitude[channel_nr] = sqrtf(sum / nr_samples);
+	if (!publish)
+		return false;
 
-		channel_nr++;
+	uint32_t nr_frames = volmeter->pending_frames;
+	levels->nr_channels = (uint32_t)nr_channels;
+	levels->nr_frames = nr_frames;
+	for (int ch = 0; ch < nr_channels; ch++) {
+		levels->peak[ch] = volmeter->pending_peak[ch];
+		levels->magnitude[ch] = nr_frames ? sqrtf(volmeter->pending_sum_squares[ch] / nr_frames) : 0.0f;
 	}
-}
 
-static void volmeter_process_audio_data(volmeter_t *volmeter, const struct audio_data *data)
-{
-	int nr_channels = get_nr_channels_from_audio_data(data);
+	levels->has_loudness = volmeter->loudness != NULL;
+	if (volmeter->loudness)
+		loudness_get_values(volmeter->loudness, &levels->loudness);
 
-	volmeter_process_peak(volmeter, data, nr_channels);
-	volmeter_process_magnitude(volmeter, data, nr_channels);
+	volmeter_reset_pending(volmeter, (uint32_t)nr_channels);
+	return true;
 }
 
 void volmeter_push_audio_data(volmeter_t *volmeter, const struct audio_data *data)
 {
-	float magnitude[MAX_AUDIO_CHANNELS];
-	float peak[MAX_AUDIO_CHANNELS];
+	struct volmeter_levels_s levels;
 
+	/* The values are passed to the callbacks in linear scale. Conversion
+	 * to dB is left to the consumer, which usually needs only the latest
+	 * value once per video frame. */
+	uint64_t ts = os_gettime_ns();
 	pthread_mutex_lock(&volmeter->mutex);
+	bool publish = volmeter_process_audio_data(volmeter, data, &levels);
+	struct meter_cb_list *callbacks = publish ? callbacks_acquire(volmeter) : NULL;
+	pthread_mutex_unlock(&volmeter->mutex);
 
-	volmeter_process_audio_data(volmeter, data);
+	uint64_t ts_signal = os_gettime_ns();
+	latency_stats_add(&volmeter->latency[VOLMETER_STAGE_PROCESS], ts_signal - ts);
+
+	if (!callbacks)
+		return;
 
-	for (int channel_nr = 0; channel_nr < MAX_AUDIO_CHANNELS; channel_nr++) {
-		magnitude[channel_nr] = mul_to_db(volmeter->magnitude[channel_nr]);
-		peak[channel_nr] = mul_to_db(volmeter->peak[channel_nr]);
+	signal_levels_updated(callbacks, &levels);
+	callbacks_release(volmeter, callbacks);
+	latency_stats_end(&volmeter->latency[VOLMETER_STAGE_SIGNAL], ts_signal);
+}
+
+const char *volmeter_stage_name(enum volmeter_stage stage)
+{
+	switch (stage) {
+	case VOLMETER_STAGE_AUDIO_CB:
+		return "audio_cb";
+	case VOLMETER_STAGE_PROCESS:
+		return "process";
+	case VOLMETER_STAGE_SIGNAL:
+		return "signal";
+	default:
+		return "unknown";
 	}
+}
 
-	pthread_mutex_unlock(&volmeter->mutex);
+struct latency_stats_s *volmeter_get_latency_stats(volmeter_t *volmeter, enum volmeter_stage stage)
+{
+	if (!volmeter || stage < 0 || stage >= VOLMETER_NR_STAGES)
+		return NULL;
+	return &volmeter->latency[stage];
+}
 
-	signal_levels_updated(volmeter, magnitude, peak, peak);
+void volmeter_log_latency_stats(volmeter_t *volmeter, const char *context)
+{
+	for (int i = 0; i < VOLMETER_NR_STAGES; i++)
+		latency_stats_log(&volmeter->latency[i], context, volmeter_stage_name(i));
 }
 
 volmeter_t *volmeter_create()
@@ -345,9 +388,16 @@ volmeter_t *volmeter_create()
 		goto fail1;
 	if (pthread_mutex_init(&volmeter->callback_mutex, NULL) != 0)
 		goto fail2;
+	if (os_event_init(&volmeter->retired_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail3;
+
+	volmeter->kernel = volmeter_kernel_get();
+	blog(LOG_DEBUG, "volmeter_create: using %s kernel", volmeter->kernel->name);
 
 	return volmeter;
 
+fail3:
+	pthread_mutex_destroy(&volmeter->callback_mutex);
 fail2:
 	pthread_mutex_destroy(&volmeter->mutex);
 fail1:
@@ -360,24 +410,72 @@ void volmeter_destroy(volmeter_t *volmeter)
 	if (!volmeter)
 		return;
 
-	da_free(volmeter->callbacks);
+	/* The audio data is not pushed anymore so that all the replaced
+	 * lists have been freed. */
+	loudness_destroy(volmeter->loudness);
+	bfree(volmeter->callbacks);
+	os_event_destroy(volmeter->retired_event);
 	pthread_mutex_destroy(&volmeter->callback_mutex);
 	pthread_mutex_destroy(&volmeter->mutex);
 
 	bfree(volmeter);
 }
 
-void volmeter_set_peak_meter_type(volmeter_t *volmeter, enum obs_peak_meter_type peak_meter_type)
+void volmeter_set_peak_meter_type(volmeter_t *volmeter, enum volmeter_peak_type peak_meter_type)
 {
 	pthread_mutex_lock(&volmeter->mutex);
 	volmeter->peak_meter_type = peak_meter_type;
 	pthread_mutex_unlock(&volmeter->mutex);
 }
 
+void volmeter_set_update_interval(volmeter_t *volmeter, unsigned int update_ms)
+{
+	int64_t update_frames = 0;
+	struct obs_audio_info audio_info;
+	if (update_ms && obs_get_audio_info(&audio_info))
+		update_frames = (int64_t)update_ms * audio_info.samples_per_sec / 1000;
+
+	pthread_mutex_lock(&volmeter->mutex);
+	volmeter->update_ms = update_ms;
+	volmeter->update_frames = update_frames;
+	volmeter->frames_to_publish = 0;
+	pthread_mutex_unlock(&volmeter->mutex);
+}
+
+void volmeter_set_loudness(volmeter_t *volmeter, bool enable)
+{
+	loudness_t *loudness = NULL;
+	if (enable) {
+		struct obs_audio_info audio_info;
+		if (obs_get_audio_info(&audio_info))
+			loudness = loudness_create(audio_info.samples_per_sec);
+		if (!loudness)
+			blog(LOG_ERROR, "volmeter_set_loudness: failed to create loudness meter");
+	}
+
+	pthread_mutex_lock(&volmeter->mutex);
+	loudness_t *prev = volmeter->loudness;
+	volmeter->loudness = loudness;
+	pthread_mutex_unlock(&volmeter->mutex);
+
+	loudness_destroy(prev);
+}
+
+void volmeter_reset_loudness(volmeter_t *volmeter)
+{
+	pthread_mutex_lock(&volmeter->mutex);
+	if (volmeter->loudness)
+		loudness_reset(volmeter->loudness);
+	pthread_mutex_unlock(&volmeter->mutex);
+}
+
 uint32_t volmeter_get_nr_channels(volmeter_t *volmeter)
 {
-	UNUSED_PARAMETER(volmeter);
+	long nr_channels = volmeter ? os_atomic_load_long(&volmeter->nr_channels) : 0;
+	if (nr_channels > 0)
+		return (uint32_t)nr_channels;
 
+	/* No audio data has come yet. */
 	struct obs_audio_info audio_info;
 	if (obs_get_audio_info(&audio_info)) {
 		return get_audio_channels(audio_info.speakers);
@@ -387,7 +485,7 @@ uint32_t volmeter_get_nr_channels(volmeter_t *volmeter)
 	}
 }
 
-void volmeter_add_callback(volmeter_t *volmeter, obs_volmeter_updated_t callback, void *param)
+void volmeter_add_callback(volmeter_t *volmeter, volmeter_updated_t callback, void *param)
 {
 	struct meter_cb cb = {callback, param};
 
@@ -395,11 +493,11 @@ void volmeter_add_callback(volmeter_t *volmeter, obs_volmeter_updated_t callback
 		return;
 
 	pthread_mutex_lock(&volmeter->callback_mutex);
-	da_push_back(volmeter->callbacks, &cb);
+	callbacks_replace(volmeter, callbacks_create(volmeter->callbacks, &cb, true));
 	pthread_mutex_unlock(&volmeter->callback_mutex);
 }
 
-void volmeter_remove_callback(volmeter_t *volmeter, obs_volmeter_updated_t callback, void *param)
+void volmeter_remove_callback(volmeter_t *volmeter, volmeter_updated_t callback, void *param)
 {
 	struct meter_cb cb = {callback, param};
 
@@ -407,6 +505,9 @@ void volmeter_remove_callback(volmeter_t *volmeter, obs_volmeter_updated_t callb
 		return;
 
 	pthread_mutex_lock(&volmeter->callback_mutex);
-	da_erase_item(volmeter->callbacks, &cb);
+	callbacks_replace(volmeter, callbacks_create(volmeter->callbacks, &cb, false));
+
+	/* Make sure the removed callback won't be called after returning. */
+	callbacks_wait_retired(volmeter);
 	pthread_mutex_unlock(&volmeter->callback_mutex);
 }
@@ -20,19 +20,85 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include "loudness.h"
+#include "latency-stats.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 typedef struct volmeter_s volmeter_t;
 
+/* Peak meter types. The first two are same as `enum obs_peak_meter_type`
+ * so that the profile setting can be used as is. */
+enum volmeter_peak_type {
+	VOLMETER_SAMPLE_PEAK = SAMPLE_PEAK_METER,
+	VOLMETER_TRUE_PEAK = TRUE_PEAK_METER,
+	VOLMETER_TRUE_PEAK_FIR4, // ITU-R BS.1770-4, 4x oversampling
+	VOLMETER_TRUE_PEAK_FIR8, // 8x oversampling
+};
+
+static inline enum volmeter_peak_type peak_meter_type_from_int(int value)
+{
+	switch (value) {
+	case 0:
+		return VOLMETER_SAMPLE_PEAK;
+	case 1:
+		return VOLMETER_TRUE_PEAK;
+	case 2:
+		return VOLMETER_TRUE_PEAK_FIR4;
+	case 3:
+		return VOLMETER_TRUE_PEAK_FIR8;
+	default:
+		return VOLMETER_SAMPLE_PEAK;
+	}
+}
+
+/* Levels of one audio packet in linear scale.
+ * Only the first `nr_channels` elements are valid.
+ * `nr_frames` is the number of the samples per channel, to be used as the
+ * weight of `magnitude` when accumulating several packets.
+ * `loudness` is valid only if `has_loudness` is set, and is the latest value
+ * including this packet instead of the value of this packet only. */
+struct volmeter_levels_s
+{
+	uint32_t nr_channels;
+	uint32_t nr_frames;
+	float magnitude[MAX_AUDIO_CHANNELS];
+	float peak[MAX_AUDIO_CHANNELS];
+	bool has_loudness;
+	struct loudness_values_s loudness;
+};
+
+/* Stages of the audio thread whose time is recorded. */
+enum volmeter_stage {
+	VOLMETER_STAGE_AUDIO_CB, // whole raw audio callback, recorded by the caller
+	VOLMETER_STAGE_PROCESS,  // peak, magnitude, and loudness
+	VOLMETER_STAGE_SIGNAL,   // callbacks of the consumers
+	VOLMETER_NR_STAGES,
+};
+
+const char *volmeter_stage_name(enum volmeter_stage stage);
+
+typedef void (*volmeter_updated_t)(void *param, const struct volmeter_levels_s *levels);
+
 volmeter_t *volmeter_create();
 void volmeter_destroy(volmeter_t *volmeter);
-void volmeter_set_peak_meter_type(volmeter_t *volmeter, enum obs_peak_meter_type peak_meter_type);
+void volmeter_set_peak_meter_type(volmeter_t *volmeter, enum volmeter_peak_type peak_meter_type);
+void volmeter_set_loudness(volmeter_t *volmeter, bool enable);
+/* Restarts the integrated loudness if the loudness is enabled. */
+void volmeter_reset_loudness(volmeter_t *volmeter);
+/* Publishes the levels every `update_ms` on average instead of every packet
+ * if not 0. */
+void volmeter_set_update_interval(volmeter_t *volmeter, unsigned int update_ms);
 uint32_t volmeter_get_nr_channels(volmeter_t *volmeter);
-void volmeter_add_callback(volmeter_t *volmeter, obs_volmeter_updated_t callback, void *param);
-void volmeter_remove_callback(volmeter_t *volmeter, obs_volmeter_updated_t callback, void *param);
+void volmeter_add_callback(volmeter_t *volmeter, volmeter_updated_t callback, void *param);
+/* Returns after the callback returns if it is being called, so `param` can be
+ * freed after that. Cannot be called from the callback. */
+void volmeter_remove_callback(volmeter_t *volmeter, volmeter_updated_t callback, void *param);
 void volmeter_push_audio_data(volmeter_t *volmeter, const struct audio_data *data);
+struct latency_stats_s *volmeter_get_latency_stats(volmeter_t *volmeter, enum volmeter_stage stage);
+void volmeter_log_latency_stats(volmeter_t *volmeter, const char *context);
 
 #ifdef __cplusplus
 }